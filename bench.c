@@ -0,0 +1,726 @@
+/*
+ * CS 261 Data Structures
+ * Benchmarks of the hash maps and the spell checker.
+ *
+ * Key sets and queries come from fixed seeds and every timing is the median
+ * of several runs, so the output of two builds can be compared line by line.
+ * Build with "make bench", which optimizes and turns asserts off, and run it
+ * from the project directory so dictionary.txt is found:
+ *
+ *     ./bench [--quick] [--repeat N]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "hashMap.h"
+#include "frozenMap.h"
+#include "editDistance.h"
+#include "topK.h"
+#include "suggestions.h"
+#include "wordScanner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define DICTIONARY_PATH "dictionary.txt"
+#define SNAPSHOT_PATH "bench.snapshot"
+#define FROZEN_PATH "bench.frozen"
+// Most runs a timing can be the median of.
+#define MAX_REPEAT 31
+// Slow hash functions are only timed in tables up to this many keys.
+#define MAX_LEGACY_KEYS 10000
+// Suggestions asked for per query, as in the spell checker.
+#define SUGGESTIONS 5
+
+typedef struct NamedHash NamedHash;
+typedef struct NamedEngine NamedEngine;
+typedef struct KeySet KeySet;
+
+struct NamedHash
+{
+    const char* name;
+    HashFunction function;
+    // Nonzero for the functions kept only for comparison.
+    int legacy;
+};
+
+struct NamedEngine
+{
+    const char* name;
+    HashMapEngine engine;
+    // Buckets migrated per operation, or 0 to resize all at once.
+    int resizeStep;
+};
+
+struct KeySet
+{
+    // Keys stored back to back, each null terminated.
+    char* bytes;
+    const char** keys;
+    int count;
+};
+
+static const NamedHash hashes[] = {
+    {"legacy1", hashFunctionLegacy1, 1},
+    {"legacy2", hashFunctionLegacy2, 1},
+    {"fnv1a", hashFunctionFnv1a, 0},
+    {"wyhash", hashFunctionWy, 0},
+};
+
+static const NamedEngine engines[] = {
+    {"chained", HASH_MAP_CHAINED, 0},
+    {"chained-incr", HASH_MAP_CHAINED, 4},
+    {"linear", HASH_MAP_LINEAR_PROBING, 0},
+    {"group", HASH_MAP_GROUP_PROBING, 0},
+};
+
+static int repeat = 5;
+static int quick = 0;
+// Results are added up here so the compiler can't drop the work.
+static volatile long long sink;
+
+/**
+ * Returns a monotonic time in seconds.
+ */
+static double now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/**
+ * Returns the next number of a xorshift generator, so inputs don't depend on
+ * the C library's rand.
+ */
+static uint64_t nextRandom(uint64_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int compareDoubles(const void* left, const void* right)
+{
+    double a = *(const double*)left;
+    double b = *(const double*)right;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Returns the median of some timings, sorting them.
+ */
+static double median(double* samples, int count)
+{
+    qsort(samples, count, sizeof(double), compareDoubles);
+    return samples[count / 2];
+}
+
+/**
+ * Returns a percentile of sorted samples.
+ */
+static double percentile(const double* sorted, int count, double fraction)
+{
+    int index = (int)(fraction * count);
+    return sorted[index < count ? index : count - 1];
+}
+
+/**
+ * Returns the resident set size of the process in KiB, or -1 where
+ * /proc/self/statm isn't available.
+ */
+static long residentKiB(void)
+{
+    long pages;
+    long resident;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    int read = fscanf(file, "%ld %ld", &pages, &resident);
+    fclose(file);
+    return read == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+}
+
+/**
+ * Returns the largest resident set size of the process so far in KiB.
+ */
+static long peakResidentKiB(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Creates count distinct random keys of 3 to 23 characters starting with the
+ * given letter. Key sets with different letters share no keys.
+ */
+static KeySet keySetNew(int count, char first, uint64_t seed)
+{
+    KeySet set;
+    uint64_t state = seed * 0x9E3779B97F4A7C15ull + 1;
+    char* next;
+
+    set.count = count;
+    set.bytes = malloc((size_t)count * 24);
+    set.keys = malloc(sizeof(char*) * count);
+    next = set.bytes;
+    for (int i = 0; i < count; i++)
+    {
+        // The index keeps the keys distinct; the random part varies their
+        // length and bytes.
+        uint64_t random = nextRandom(&state) >> (nextRandom(&state) % 64);
+        set.keys[i] = next;
+        next += sprintf(next, "%c%x%llx", first, i, (unsigned long long)random) + 1;
+    }
+    return set;
+}
+
+static void keySetDelete(KeySet* set)
+{
+    free(set->keys);
+    free(set->bytes);
+}
+
+/**
+ * Reads a whole file into memory with a spare byte for a terminator.
+ * @return The contents, or NULL if the file can't be read.
+ */
+static char* readFile(const char* path, size_t* length)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    rewind(file);
+    char* buffer = malloc(*length + 1);
+    *length = fread(buffer, 1, *length, file);
+    fclose(file);
+    return buffer;
+}
+
+/**
+ * Times each hash function on the dictionary's words and on longer keys.
+ */
+static void benchHashFunctions(const KeySet* words)
+{
+    char longKey[256];
+    int longCount = quick ? 100000 : 1000000;
+
+    for (int i = 0; i < (int)sizeof(longKey); i++)
+    {
+        longKey[i] = 'a' + i % 26;
+    }
+    printf("\n== Hash functions (ns per key, median of %d) ==\n", repeat);
+    printf("%-10s %12s %12s %12s\n", "function", "words", "64 bytes", "256 bytes");
+    for (int h = 0; h < (int)(sizeof(hashes) / sizeof(hashes[0])); h++)
+    {
+        double wordTimes[MAX_REPEAT];
+        double shortTimes[MAX_REPEAT];
+        double longTimes[MAX_REPEAT];
+        HashFunction function = hashes[h].function;
+        for (int r = 0; r < repeat; r++)
+        {
+            uint64_t total = 0;
+            double start = now();
+            for (int i = 0; i < words->count; i++)
+            {
+                total += function(words->keys[i], strlen(words->keys[i]), 0);
+            }
+            double middle = now();
+            for (int i = 0; i < longCount; i++)
+            {
+                total += function(longKey, 64, i);
+            }
+            double end = now();
+            for (int i = 0; i < longCount; i++)
+            {
+                total += function(longKey, 256, i);
+            }
+            wordTimes[r] = (middle - start) / words->count;
+            shortTimes[r] = (end - middle) / longCount;
+            longTimes[r] = (now() - end) / longCount;
+            sink += total;
+        }
+        printf("%-10s %12.1f %12.1f %12.1f\n", hashes[h].name,
+               median(wordTimes, repeat) * 1e9, median(shortTimes, repeat) * 1e9,
+               median(longTimes, repeat) * 1e9);
+    }
+}
+
+/**
+ * Times inserts, hits, misses, batched hits and removes of every key of a set
+ * in one engine with one hash function.
+ */
+static void benchTable(const NamedEngine* engine, const NamedHash* hash,
+                       const KeySet* keys, const KeySet* missing)
+{
+    double times[5][MAX_REPEAT];
+    float load = 0;
+    int** values = malloc(sizeof(int*) * keys->count);
+
+    for (int r = 0; r < repeat; r++)
+    {
+        long long found = 0;
+        HashMap* map = hashMapNewEngine(16, engine->engine);
+        hashMapSetHashFunction(map, hash->function, 0);
+        hashMapSetIncrementalResize(map, engine->resizeStep);
+
+        double start = now();
+        for (int i = 0; i < keys->count; i++)
+        {
+            hashMapPut(map, keys->keys[i], i);
+        }
+        times[0][r] = now() - start;
+        load = hashMapTableLoad(map);
+
+        start = now();
+        for (int i = 0; i < keys->count; i++)
+        {
+            found += hashMapGet(map, keys->keys[i]) != NULL;
+        }
+        times[1][r] = now() - start;
+
+        start = now();
+        for (int i = 0; i < missing->count; i++)
+        {
+            found += hashMapContainsKey(map, missing->keys[i]);
+        }
+        times[2][r] = now() - start;
+
+        start = now();
+        found += hashMapGetBatch(map, keys->keys, keys->count, values);
+        times[3][r] = now() - start;
+
+        start = now();
+        for (int i = 0; i < keys->count; i++)
+        {
+            hashMapRemove(map, keys->keys[i]);
+        }
+        times[4][r] = now() - start;
+
+        sink += found;
+        hashMapDelete(map);
+    }
+    printf("%-13s %-8s %8d %6.2f", engine->name, hash->name, keys->count, load);
+    for (int t = 0; t < 5; t++)
+    {
+        printf(" %9.1f", median(times[t], repeat) / keys->count * 1e9);
+    }
+    printf("\n");
+    free(values);
+}
+
+/**
+ * Times the read-only tables, a snapshot and a frozen map, against the last
+ * key set of benchTables.
+ */
+static void benchReadOnlyTables(const KeySet* keys, const KeySet* missing)
+{
+    double times[3][MAX_REPEAT];
+    const int** values = malloc(sizeof(int*) * keys->count);
+    HashMap* map = hashMapNewEngine(16, HASH_MAP_GROUP_PROBING);
+    hashMapPutBatch(map, keys->keys, keys->count, 0);
+    hashMapSave(map, SNAPSHOT_PATH);
+
+    HashMap* snapshot = hashMapLoadSnapshot(SNAPSHOT_PATH);
+    FrozenMap* frozen = NULL;
+    double buildTimes[MAX_REPEAT];
+    for (int r = 0; r < repeat; r++)
+    {
+        if (frozen != NULL)
+        {
+            frozenMapDelete(frozen);
+        }
+        double start = now();
+        frozen = frozenMapNew(map);
+        buildTimes[r] = now() - start;
+    }
+    hashMapDelete(map);
+
+    for (int r = 0; r < repeat; r++)
+    {
+        long long found = 0;
+        double start = now();
+        for (int i = 0; i < keys->count; i++)
+        {
+            found += hashMapGet(snapshot, keys->keys[i]) != NULL;
+        }
+        times[0][r] = now() - start;
+        start = now();
+        for (int i = 0; i < missing->count; i++)
+        {
+            found += hashMapContainsKey(snapshot, missing->keys[i]);
+        }
+        times[1][r] = now() - start;
+        start = now();
+        found += hashMapGetBatch(snapshot, keys->keys, keys->count, (int**)values);
+        times[2][r] = now() - start;
+        sink += found;
+    }
+    printf("%-13s %-8s %8d %6.2f %9s", "snapshot", "wyhash", keys->count,
+           hashMapTableLoad(snapshot), "-");
+    for (int t = 0; t < 3; t++)
+    {
+        printf(" %9.1f", median(times[t], repeat) / keys->count * 1e9);
+    }
+    printf(" %9s\n", "-");
+    hashMapDelete(snapshot);
+    remove(SNAPSHOT_PATH);
+
+    for (int r = 0; r < repeat; r++)
+    {
+        long long found = 0;
+        double start = now();
+        for (int i = 0; i < keys->count; i++)
+        {
+            found += frozenMapGet(frozen, keys->keys[i]) != NULL;
+        }
+        times[0][r] = now() - start;
+        start = now();
+        for (int i = 0; i < missing->count; i++)
+        {
+            found += frozenMapContainsKey(frozen, missing->keys[i]);
+        }
+        times[1][r] = now() - start;
+        start = now();
+        found += frozenMapGetBatch(frozen, keys->keys, keys->count, values);
+        times[2][r] = now() - start;
+        sink += found;
+    }
+    // A frozen map is built rather than inserted into; its build time per
+    // key takes the insert column.
+    printf("%-13s %-8s %8d %6.2f %9.1f", "frozen", "wyhash", keys->count, 1.0,
+           median(buildTimes, repeat) / keys->count * 1e9);
+    for (int t = 0; t < 3; t++)
+    {
+        printf(" %9.1f", median(times[t], repeat) / keys->count * 1e9);
+    }
+    printf(" %9s\n", "-");
+    frozenMapDelete(frozen);
+    free(values);
+}
+
+/**
+ * Times every engine with every hash function at several sizes. Tables
+ * double as they grow, so the sizes also land at different loads, which are
+ * printed with the results.
+ */
+static void benchTables(void)
+{
+    int sizes[] = {1000, 10000, 100000, 700000, 1000000};
+    int sizeCount = quick ? 3 : 5;
+    KeySet keys;
+    KeySet missing;
+
+    printf("\n== Tables (ns per operation, median of %d) ==\n", repeat);
+    printf("%-13s %-8s %8s %6s %9s %9s %9s %9s %9s\n", "engine", "hash", "keys", "load",
+           "insert", "hit", "miss", "batchHit", "remove");
+    for (int s = 0; s < sizeCount; s++)
+    {
+        keys = keySetNew(sizes[s], 'k', s + 1);
+        missing = keySetNew(sizes[s], 'm', s + 1);
+        for (int e = 0; e < (int)(sizeof(engines) / sizeof(engines[0])); e++)
+        {
+            for (int h = 0; h < (int)(sizeof(hashes) / sizeof(hashes[0])); h++)
+            {
+                if (!hashes[h].legacy || sizes[s] <= MAX_LEGACY_KEYS)
+                {
+                    benchTable(&engines[e], &hashes[h], &keys, &missing);
+                }
+            }
+        }
+        if (s + 1 < sizeCount)
+        {
+            keySetDelete(&keys);
+            keySetDelete(&missing);
+        }
+    }
+    benchReadOnlyTables(&keys, &missing);
+    keySetDelete(&keys);
+    keySetDelete(&missing);
+}
+
+/**
+ * Times each step of loading the dictionary the way the spell checker does,
+ * with the resident memory after each step.
+ * @return The frozen dictionary, for the suggestion benchmarks.
+ */
+static FrozenMap* benchDictionary(const char* text, size_t length)
+{
+    double times[6][MAX_REPEAT];
+    long resident[4] = {0, 0, 0, 0};
+    long before = residentKiB();
+    FrozenMap* frozen = NULL;
+    char* buffer = malloc(length + 1);
+
+    for (int r = 0; r < repeat; r++)
+    {
+        if (frozen != NULL)
+        {
+            frozenMapDelete(frozen);
+        }
+        memcpy(buffer, text, length);
+
+        double start = now();
+        int count;
+        char** words = splitWords(buffer, length, &count);
+        HashMap* map = hashMapNewEngine(1000, HASH_MAP_GROUP_PROBING);
+        hashMapSetBorrowedKeys(map, 1);
+        hashMapPutBatch(map, (const char**)words, count, -1);
+        free(words);
+        times[0][r] = now() - start;
+        resident[0] = residentKiB();
+
+        start = now();
+        hashMapSave(map, SNAPSHOT_PATH);
+        times[1][r] = now() - start;
+
+        start = now();
+        HashMap* snapshot = hashMapLoadSnapshot(SNAPSHOT_PATH);
+        times[2][r] = now() - start;
+        resident[1] = residentKiB();
+        hashMapDelete(snapshot);
+
+        start = now();
+        frozen = frozenMapNew(map);
+        times[3][r] = now() - start;
+        hashMapDelete(map);
+        resident[2] = residentKiB();
+
+        start = now();
+        frozenMapSave(frozen, FROZEN_PATH);
+        times[4][r] = now() - start;
+
+        start = now();
+        FrozenMap* loaded = frozenMapLoad(FROZEN_PATH);
+        times[5][r] = now() - start;
+        resident[3] = residentKiB();
+        frozenMapDelete(loaded);
+    }
+    remove(SNAPSHOT_PATH);
+    remove(FROZEN_PATH);
+    free(buffer);
+
+    printf("\n== Dictionary (%d words; ms, median of %d; RSS in KiB) ==\n",
+           frozenMapSize(frozen), repeat);
+    printf("%-24s %10s %10s\n", "step", "time", "RSS");
+    printf("%-24s %10s %10ld\n", "before", "-", before);
+    printf("%-24s %10.2f %10ld\n", "build group table", median(times[0], repeat) * 1e3,
+           resident[0]);
+    printf("%-24s %10.2f %10s\n", "save snapshot", median(times[1], repeat) * 1e3, "-");
+    printf("%-24s %10.2f %10ld\n", "load snapshot", median(times[2], repeat) * 1e3,
+           resident[1]);
+    printf("%-24s %10.2f %10ld\n", "freeze", median(times[3], repeat) * 1e3, resident[2]);
+    printf("%-24s %10.2f %10s\n", "save frozen", median(times[4], repeat) * 1e3, "-");
+    printf("%-24s %10.2f %10ld\n", "load frozen", median(times[5], repeat) * 1e3,
+           resident[3]);
+    return frozen;
+}
+
+/**
+ * Makes a misspelling of a dictionary word with one or two random edits.
+ */
+static void misspell(const char* word, char* query, uint64_t* state)
+{
+    size_t length = strlen(word);
+    int edits = 1 + nextRandom(state) % 2;
+
+    memcpy(query, word, length + 1);
+    for (int e = 0; e < edits; e++)
+    {
+        size_t at = length == 0 ? 0 : nextRandom(state) % length;
+        char letter = 'a' + nextRandom(state) % 26;
+        switch (nextRandom(state) % 3)
+        {
+        case 0:
+            if (length > 0)
+            {
+                query[at] = letter;
+            }
+            break;
+        case 1:
+            memmove(query + at + 1, query + at, length - at + 1);
+            query[at] = letter;
+            length++;
+            break;
+        default:
+            if (length > 1)
+            {
+                memmove(query + at, query + at + 1, length - at);
+                length--;
+            }
+        }
+    }
+}
+
+/**
+ * Prints latency percentiles of some samples in microseconds.
+ */
+static void printLatencies(const char* name, double* samples, int count)
+{
+    double total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        total += samples[i];
+    }
+    qsort(samples, count, sizeof(double), compareDoubles);
+    printf("%-16s %8d %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, count, total / count * 1e6,
+           percentile(samples, count, 0.5) * 1e6, percentile(samples, count, 0.9) * 1e6,
+           percentile(samples, count, 0.99) * 1e6, samples[count - 1] * 1e6);
+}
+
+/**
+ * Times suggestion queries for misspelled dictionary words, with a scan of the
+ * dictionary on one thread and on one thread per processor, and with a
+ * deletion index.
+ */
+static void benchSuggestions(const FrozenMap* dictionary)
+{
+    int queryCount = quick ? 200 : 1000;
+    char (*queries)[64] = malloc(sizeof(*queries) * queryCount);
+    double* latencies = malloc(sizeof(double) * queryCount);
+    uint64_t state = 261;
+    TopK nearest;
+
+    for (int q = 0; q < queryCount; q++)
+    {
+        const char* word;
+        do
+        {
+            word = frozenMapKey(dictionary, nextRandom(&state) % frozenMapSize(dictionary));
+        } while (strlen(word) > 60);
+        misspell(word, queries[q], &state);
+    }
+    topKInit(&nearest, SUGGESTIONS);
+
+    printf("\n== Suggestions (%d per query; microseconds) ==\n", SUGGESTIONS);
+    printf("%-16s %8s %9s %9s %9s %9s %9s\n", "method", "queries", "mean", "p50", "p90",
+           "p99", "max");
+    for (int q = 0; q < queryCount; q++)
+    {
+        double start = now();
+        suggestionScan(dictionary, queries[q], INT_MAX, &nearest);
+        latencies[q] = now() - start;
+        topKClear(&nearest);
+    }
+    printLatencies("scan", latencies, queryCount);
+
+    // Threads started per query against a pool started once, with at least
+    // two threads so that there are threads to start.
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 2 ? 2 : threads;
+    SuggestionPool* pool = suggestionPoolNew(threads);
+    for (int q = 0; q < queryCount; q++)
+    {
+        double start = now();
+        suggestionScanParallel(dictionary, queries[q], INT_MAX, &nearest, threads);
+        latencies[q] = now() - start;
+        topKClear(&nearest);
+    }
+    printLatencies("threads per call", latencies, queryCount);
+    for (int q = 0; q < queryCount; q++)
+    {
+        double start = now();
+        suggestionPoolScan(pool, dictionary, queries[q], INT_MAX, &nearest);
+        latencies[q] = now() - start;
+        topKClear(&nearest);
+    }
+    printLatencies("thread pool", latencies, queryCount);
+    suggestionPoolDelete(pool);
+
+    // Lookups of the query's deletion strings, on one thread like the scan.
+    // Queries with fewer suggestions within SUGGESTION_INDEX_DISTANCE than
+    // asked for still scan, unless suggestions are limited to that distance.
+    long before = residentKiB();
+    double start = now();
+    SuggestionIndex* index = suggestionIndexNew(dictionary);
+    double buildTime = now() - start;
+    long after = residentKiB();
+    for (int q = 0; q < queryCount; q++)
+    {
+        start = now();
+        suggestionIndexQuery(index, NULL, queries[q], INT_MAX, &nearest);
+        latencies[q] = now() - start;
+        topKClear(&nearest);
+    }
+    printLatencies("deletion index", latencies, queryCount);
+    for (int q = 0; q < queryCount; q++)
+    {
+        start = now();
+        suggestionScan(dictionary, queries[q], SUGGESTION_INDEX_DISTANCE, &nearest);
+        latencies[q] = now() - start;
+        topKClear(&nearest);
+    }
+    printLatencies("scan within 2", latencies, queryCount);
+    for (int q = 0; q < queryCount; q++)
+    {
+        start = now();
+        suggestionIndexQuery(index, NULL, queries[q], SUGGESTION_INDEX_DISTANCE, &nearest);
+        latencies[q] = now() - start;
+        topKClear(&nearest);
+    }
+    printLatencies("index within 2", latencies, queryCount);
+    printf("deletion index built in %.2f ms, %ld KiB\n", buildTime * 1e3, after - before);
+    suggestionIndexDelete(index);
+
+    topKRelease(&nearest);
+    free(latencies);
+    free(queries);
+}
+
+int main(int argc, const char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--quick") == 0)
+        {
+            quick = 1;
+            repeat = 3;
+        }
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = atoi(argv[++i]);
+            repeat = repeat < 1 ? 1 : repeat > MAX_REPEAT ? MAX_REPEAT : repeat;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--quick] [--repeat N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    size_t length;
+    char* text = readFile(DICTIONARY_PATH, &length);
+    if (text == NULL)
+    {
+        fprintf(stderr, "Could not read %s\n", DICTIONARY_PATH);
+        return 1;
+    }
+    char* copy = malloc(length + 1);
+    memcpy(copy, text, length);
+    KeySet words;
+    words.bytes = copy;
+    words.keys = (const char**)splitWords(copy, length, &words.count);
+
+    benchHashFunctions(&words);
+    benchTables();
+    FrozenMap* dictionary = benchDictionary(text, length);
+    benchSuggestions(dictionary);
+    printf("\nPeak RSS: %ld KiB\n", peakResidentKiB());
+
+    frozenMapDelete(dictionary);
+    keySetDelete(&words);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef CACHE_LINE_H
+#define CACHE_LINE_H
+
+/*
+ * Cache line alignment for data written by several threads. Fields or array
+ * elements written by different threads are kept a cache line apart so that
+ * a write by one doesn't invalidate the line another is using.
+ *
+ * Needs GCC or Clang for the aligned attribute. Arrays of aligned types must
+ * be allocated aligned too, e.g. with posix_memalign.
+ */
+
+// Bytes of a cache line.
+#define CACHE_LINE_SIZE 64
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE_SIZE)))
+
+#endif
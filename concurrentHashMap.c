@@ -0,0 +1,384 @@
+/*
+ * CS 261 Data Structures
+ * Hash map for concurrent use by many threads.
+ *
+ * Reclamation works like sleepable RCU with one pair of counters per segment.
+ * A reader increments the counter of the segment's current index, walks the
+ * table and decrements it again. To free what it unlinked, a writer waits for
+ * the other counter to drain of readers that entered long ago, flips the
+ * index and waits for the old counter to drain. Any reader still counted at
+ * that point entered after the unlink and can't reach the unlinked memory.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "concurrentHashMap.h"
+#include "hashMap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sched.h>
+
+// Unlinked links a segment collects before waiting for its readers to free
+// them.
+#define RETIRE_BATCH 64
+
+#define LOAD(address) __atomic_load_n(address, __ATOMIC_ACQUIRE)
+#define STORE(address, value) __atomic_store_n(address, value, __ATOMIC_RELEASE)
+
+/**
+ * Allocates an empty table.
+ */
+static ConcurrentTable *concurrentTableNew(int capacity)
+{
+    ConcurrentTable *table = malloc(sizeof(ConcurrentTable) + sizeof(ConcurrentLink *) * capacity);
+    table->capacity = capacity;
+    for (int i = 0; i < capacity; i++)
+    {
+        table->buckets[i] = NULL;
+    }
+    return table;
+}
+
+/**
+ * Allocates a link with a copy of the key stored inline.
+ */
+static ConcurrentLink *concurrentLinkNew(const char *key, uint64_t hash, int value,
+                                         ConcurrentLink *next)
+{
+    size_t size = strlen(key) + 1;
+    ConcurrentLink *link = malloc(sizeof(ConcurrentLink) + size);
+    memcpy(link->key, key, size);
+    link->hash = hash;
+    link->value = value;
+    link->next = next;
+    return link;
+}
+
+/**
+ * Returns the segment that holds a hash. Segments use the high bits of the
+ * hash and buckets the low bits, so the two choices are independent.
+ */
+static ConcurrentSegment *segmentFor(ConcurrentHashMap *map, uint64_t hash)
+{
+    return &map->segments[(hash >> 32) & (map->segmentCount - 1)];
+}
+
+/**
+ * Enters a segment as a reader.
+ * @return The index to leave with.
+ */
+static int readerEnter(ConcurrentSegment *segment)
+{
+    int index = __atomic_load_n(&segment->readerIndex, __ATOMIC_RELAXED) & 1;
+    __atomic_fetch_add(&segment->readers[index], 1, __ATOMIC_RELAXED);
+    // Pairs with the fence in waitForReaders: either the writer sees this
+    // reader, or this reader sees everything the writer unlinked before.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return index;
+}
+
+/**
+ * Leaves a segment entered with readerEnter.
+ */
+static void readerLeave(ConcurrentSegment *segment, int index)
+{
+    __atomic_fetch_sub(&segment->readers[index], 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Waits until one of a segment's reader counters is zero. Readers never block
+ * inside a segment, so this doesn't take long.
+ */
+static void drainReaders(ConcurrentSegment *segment, int index)
+{
+    while (LOAD(&segment->readers[index]) != 0)
+    {
+        sched_yield();
+    }
+}
+
+/**
+ * Waits until no reader of the segment can still reach memory unlinked
+ * before the call. Only called by the writer holding the segment's lock.
+ */
+static void waitForReaders(ConcurrentSegment *segment)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int index = segment->readerIndex;
+    // Readers that read the index before the last flip but counted
+    // themselves after its wait are on the other side.
+    drainReaders(segment, index ^ 1);
+    __atomic_store_n(&segment->readerIndex, index ^ 1, __ATOMIC_SEQ_CST);
+    drainReaders(segment, index);
+}
+
+/**
+ * Frees everything a segment retired, once its readers are done with it.
+ */
+static void reclaim(ConcurrentSegment *segment)
+{
+    if (segment->retiredCount == 0)
+    {
+        return;
+    }
+    waitForReaders(segment);
+    for (int i = 0; i < segment->retiredCount; i++)
+    {
+        free(segment->retired[i]);
+    }
+    segment->retiredCount = 0;
+}
+
+/**
+ * Queues unreachable memory of a segment to be freed after a grace period.
+ */
+static void retire(ConcurrentSegment *segment, void *memory)
+{
+    if (segment->retiredCount == segment->retiredCapacity)
+    {
+        segment->retiredCapacity *= 2;
+        segment->retired = realloc(segment->retired, sizeof(void *) * segment->retiredCapacity);
+    }
+    segment->retired[segment->retiredCount++] = memory;
+}
+
+/**
+ * Doubles the buckets of a segment. Readers may be walking the old table, so
+ * its links are copied rather than moved, and the old table and links are
+ * retired. Only this segment's writers wait.
+ */
+static void segmentResize(ConcurrentSegment *segment)
+{
+    ConcurrentTable *oldTable = segment->table;
+    ConcurrentTable *table = concurrentTableNew(oldTable->capacity * 2);
+
+    for (int i = 0; i < oldTable->capacity; i++)
+    {
+        for (ConcurrentLink *link = oldTable->buckets[i]; link != NULL; link = link->next)
+        {
+            int index = link->hash & (table->capacity - 1);
+            table->buckets[index] = concurrentLinkNew(link->key, link->hash, link->value,
+                                                      table->buckets[index]);
+            retire(segment, link);
+        }
+    }
+    // The new table is complete before it becomes visible.
+    STORE(&segment->table, table);
+    retire(segment, oldTable);
+    reclaim(segment);
+}
+
+/**
+ * Creates a concurrent map.
+ * @param capacity The initial number of buckets, split across the segments.
+ * @param segmentCount Number of independently locked segments, rounded up to
+ * a power of two. More segments let more writers work at once.
+ * @return The allocated map, or NULL if the segments can't be allocated.
+ */
+ConcurrentHashMap *concurrentHashMapNew(int capacity, int segmentCount)
+{
+    ConcurrentHashMap *map = malloc(sizeof(ConcurrentHashMap));
+    map->hashFunction = HASH_FUNCTION;
+    map->seed = HASH_SEED;
+    map->segmentCount = 1;
+    while (map->segmentCount < segmentCount)
+    {
+        map->segmentCount *= 2;
+    }
+    int segmentCapacity = 1;
+    while (segmentCapacity * map->segmentCount < capacity)
+    {
+        segmentCapacity *= 2;
+    }
+
+    void *segments;
+    if (posix_memalign(&segments, CACHE_LINE_SIZE,
+                       sizeof(ConcurrentSegment) * map->segmentCount) != 0)
+    {
+        free(map);
+        return NULL;
+    }
+    map->segments = segments;
+    for (int i = 0; i < map->segmentCount; i++)
+    {
+        ConcurrentSegment *segment = &map->segments[i];
+        pthread_mutex_init(&segment->lock, NULL);
+        segment->table = concurrentTableNew(segmentCapacity);
+        segment->size = 0;
+        segment->readers[0] = 0;
+        segment->readers[1] = 0;
+        segment->readerIndex = 0;
+        segment->retiredCapacity = RETIRE_BATCH;
+        segment->retiredCount = 0;
+        segment->retired = malloc(sizeof(void *) * segment->retiredCapacity);
+    }
+    return map;
+}
+
+/**
+ * Frees the map and all of its links. No other thread may be using the map.
+ * @param map
+ */
+void concurrentHashMapDelete(ConcurrentHashMap *map)
+{
+    for (int i = 0; i < map->segmentCount; i++)
+    {
+        ConcurrentSegment *segment = &map->segments[i];
+        ConcurrentTable *table = segment->table;
+        for (int j = 0; j < table->capacity; j++)
+        {
+            ConcurrentLink *link = table->buckets[j];
+            while (link != NULL)
+            {
+                ConcurrentLink *next = link->next;
+                free(link);
+                link = next;
+            }
+        }
+        free(table);
+        reclaim(segment);
+        free(segment->retired);
+        pthread_mutex_destroy(&segment->lock);
+    }
+    free(map->segments);
+    free(map);
+}
+
+/**
+ * Looks a key up without taking any lock.
+ * @param map
+ * @param key
+ * @param value Set to the key's value if it is found.
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int concurrentHashMapGet(ConcurrentHashMap *map, const char *key, int *value)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    uint64_t hash = map->hashFunction(key, strlen(key), map->seed);
+    ConcurrentSegment *segment = segmentFor(map, hash);
+    int found = 0;
+
+    int index = readerEnter(segment);
+    ConcurrentTable *table = LOAD(&segment->table);
+    ConcurrentLink *link = LOAD(&table->buckets[hash & (table->capacity - 1)]);
+    while (link != NULL)
+    {
+        if (link->hash == hash && strcmp(link->key, key) == 0)
+        {
+            *value = __atomic_load_n(&link->value, __ATOMIC_RELAXED);
+            found = 1;
+            break;
+        }
+        link = LOAD(&link->next);
+    }
+    readerLeave(segment, index);
+    return found;
+}
+
+/**
+ * Updates the given key-value pair, or adds it if the key is not in the map.
+ * Only the key's segment is locked.
+ * @param map
+ * @param key
+ * @param value
+ */
+void concurrentHashMapPut(ConcurrentHashMap *map, const char *key, int value)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    uint64_t hash = map->hashFunction(key, strlen(key), map->seed);
+    ConcurrentSegment *segment = segmentFor(map, hash);
+
+    pthread_mutex_lock(&segment->lock);
+    ConcurrentTable *table = segment->table;
+    ConcurrentLink **bucket = &table->buckets[hash & (table->capacity - 1)];
+    for (ConcurrentLink *link = *bucket; link != NULL; link = link->next)
+    {
+        if (link->hash == hash && strcmp(link->key, key) == 0)
+        {
+            __atomic_store_n(&link->value, value, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&segment->lock);
+            return;
+        }
+    }
+    // The link is complete before it becomes visible.
+    STORE(bucket, concurrentLinkNew(key, hash, value, *bucket));
+    __atomic_store_n(&segment->size, segment->size + 1, __ATOMIC_RELAXED);
+    if (segment->size > table->capacity * MAX_TABLE_LOAD)
+    {
+        segmentResize(segment);
+    }
+    pthread_mutex_unlock(&segment->lock);
+}
+
+/**
+ * Removes the key and its value from the map. The link is freed once no
+ * reader can still be looking at it.
+ * @param map
+ * @param key
+ * @return 1 if the key was removed, 0 if it was not in the map.
+ */
+int concurrentHashMapRemove(ConcurrentHashMap *map, const char *key)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    uint64_t hash = map->hashFunction(key, strlen(key), map->seed);
+    ConcurrentSegment *segment = segmentFor(map, hash);
+    int removed = 0;
+
+    pthread_mutex_lock(&segment->lock);
+    ConcurrentTable *table = segment->table;
+    ConcurrentLink **link = &table->buckets[hash & (table->capacity - 1)];
+    while (*link != NULL)
+    {
+        if ((*link)->hash == hash && strcmp((*link)->key, key) == 0)
+        {
+            ConcurrentLink *unlinked = *link;
+            STORE(link, unlinked->next);
+            __atomic_store_n(&segment->size, segment->size - 1, __ATOMIC_RELAXED);
+            retire(segment, unlinked);
+            if (segment->retiredCount >= RETIRE_BATCH)
+            {
+                reclaim(segment);
+            }
+            removed = 1;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    pthread_mutex_unlock(&segment->lock);
+    return removed;
+}
+
+/**
+ * Returns 1 if the given key is in the map and 0 otherwise.
+ * @param map
+ * @param key
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int concurrentHashMapContainsKey(ConcurrentHashMap *map, const char *key)
+{
+    int value;
+    return concurrentHashMapGet(map, key, &value);
+}
+
+/**
+ * Returns the number of keys in the map. While other threads write, the
+ * count is only a snapshot of each segment at slightly different times.
+ * @param map
+ * @return Number of keys.
+ */
+int concurrentHashMapSize(ConcurrentHashMap *map)
+{
+    int size = 0;
+    for (int i = 0; i < map->segmentCount; i++)
+    {
+        size += __atomic_load_n(&map->segments[i].size, __ATOMIC_RELAXED);
+    }
+    return size;
+}
@@ -0,0 +1,77 @@
+#ifndef CONCURRENT_HASH_MAP_H
+#define CONCURRENT_HASH_MAP_H
+
+/*
+ * Hash map shared by many threads. Keys are split by hash into segments, each
+ * a chained table with its own lock and its own resize, so writers to
+ * different segments never wait for each other. Readers take no lock at all:
+ * links are published with atomic stores, and unlinked links and replaced
+ * tables are only freed after every reader that could still see them has
+ * left the segment.
+ *
+ * Needs GCC or Clang for their __atomic builtins, and POSIX threads.
+ */
+
+#include "hashFunctions.h"
+#include "cacheLine.h"
+#include <pthread.h>
+
+typedef struct ConcurrentLink ConcurrentLink;
+typedef struct ConcurrentTable ConcurrentTable;
+typedef struct ConcurrentSegment ConcurrentSegment;
+typedef struct ConcurrentHashMap ConcurrentHashMap;
+
+struct ConcurrentLink
+{
+    // Loaded atomically by readers. An unlinked link keeps its next, so a
+    // reader standing on it can still finish its walk.
+    ConcurrentLink* next;
+    uint64_t hash;
+    int value;
+    char key[];
+};
+
+struct ConcurrentTable
+{
+    // Number of buckets, a power of two.
+    int capacity;
+    ConcurrentLink* buckets[];
+};
+
+// Segments are cache line aligned, and their fields are grouped by who
+// writes them: the reader counters, which every reader writes, the fields
+// readers only read, and the writers' own state.
+struct ConcurrentSegment
+{
+    // Readers in the segment, counted under the index they entered with.
+    int readers[2] CACHE_ALIGNED;
+    // Writers flip the index to wait for the readers of one side.
+    int readerIndex CACHE_ALIGNED;
+    ConcurrentTable* table;
+    // Held by writers of the segment.
+    pthread_mutex_t lock CACHE_ALIGNED;
+    int size;
+    // Links and tables no longer reachable, freed after a grace period.
+    void** retired;
+    int retiredCount;
+    int retiredCapacity;
+};
+
+struct ConcurrentHashMap
+{
+    HashFunction hashFunction;
+    uint64_t seed;
+    // Number of segments, a power of two.
+    int segmentCount;
+    ConcurrentSegment* segments;
+};
+
+ConcurrentHashMap* concurrentHashMapNew(int capacity, int segmentCount);
+void concurrentHashMapDelete(ConcurrentHashMap* map);
+int concurrentHashMapGet(ConcurrentHashMap* map, const char* key, int* value);
+void concurrentHashMapPut(ConcurrentHashMap* map, const char* key, int value);
+int concurrentHashMapRemove(ConcurrentHashMap* map, const char* key);
+int concurrentHashMapContainsKey(ConcurrentHashMap* map, const char* key);
+int concurrentHashMapSize(ConcurrentHashMap* map);
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * CS 261 Data Structures
+ * Spell checking of whole documents.
+ */
+
+#include "documentChecker.h"
+#include "wordScanner.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ctype.h>
+
+// Bytes of the document read at a time.
+#define DOCUMENT_BLOCK (64 * 1024)
+
+/**
+ * Copies a word in lowercase and terminates the copy.
+ * @return Whether the word has a letter; numbers aren't spell checked.
+ */
+static int lowerWord(const char *text, size_t length, char *word)
+{
+    int letters = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        word[i] = tolower((unsigned char)text[i]);
+        letters |= isalpha((unsigned char)text[i]);
+    }
+    word[length] = '\0';
+    return letters != 0;
+}
+
+/**
+ * Spell checks a document. Words are maximal runs of letters, digits and
+ * apostrophes, as in the dictionary, and are looked up in lowercase; words
+ * without any letters are skipped, and words longer than MAX_WORD_LENGTH are
+ * misspelled without a lookup. The document is read DOCUMENT_BLOCK bytes
+ * at a time, and a word cut off by the end of a block is carried over to the
+ * next one.
+ * @param input Stream to read until its end.
+ * @param dictionary
+ * @param handler Called for every misspelled word.
+ * @param context Passed to the handler.
+ * @return Number of words checked, or -1 if reading the stream fails.
+ */
+long long checkDocument(FILE *input, const FrozenMap *dictionary,
+                        MisspellingHandler handler, void *context)
+{
+    assert(input != 0);
+    assert(dictionary != 0);
+    assert(handler != 0);
+
+    size_t capacity = DOCUMENT_BLOCK;
+    char *buffer = malloc(capacity);
+    // Lowercase copies of the words of a block. Words are separated by at
+    // least one byte, so their terminated copies fit in one byte more than
+    // the block.
+    char *lowered = malloc(capacity + 1);
+    int maxWords = 1024;
+    const char **words = malloc(sizeof(char *) * maxWords);
+    long long *offsets = malloc(sizeof(long long) * maxWords);
+    size_t *lengths = malloc(sizeof(size_t) * maxWords);
+    // Words short enough to be in the dictionary, in document order, and
+    // their values.
+    const char **lookups = malloc(sizeof(char *) * maxWords);
+    const int **values = malloc(sizeof(int *) * maxWords);
+    // Document offset of the first byte of the buffer.
+    long long bufferOffset = 0;
+    size_t length = 0;
+    long long checked = 0;
+    int atEnd = 0;
+
+    while (!atEnd)
+    {
+        length += fread(buffer + length, 1, capacity - length, input);
+        atEnd = length < capacity;
+
+        int count = 0;
+        char *copy = lowered;
+        size_t i = scanWordStart(buffer, 0, length);
+        while (i < length)
+        {
+            size_t end = scanWordEnd(buffer, i, length);
+            if (end == length && !atEnd)
+            {
+                // The word may go on in the next block.
+                break;
+            }
+            if (lowerWord(buffer + i, end - i, copy))
+            {
+                if (count == maxWords)
+                {
+                    maxWords *= 2;
+                    words = realloc(words, sizeof(char *) * maxWords);
+                    offsets = realloc(offsets, sizeof(long long) * maxWords);
+                    lengths = realloc(lengths, sizeof(size_t) * maxWords);
+                    lookups = realloc(lookups, sizeof(char *) * maxWords);
+                    values = realloc(values, sizeof(int *) * maxWords);
+                }
+                words[count] = copy;
+                offsets[count] = bufferOffset + i;
+                lengths[count] = end - i;
+                count++;
+                copy += end - i + 1;
+            }
+            i = scanWordStart(buffer, end, length);
+        }
+        size_t next = i;
+
+        int lookupCount = 0;
+        for (int w = 0; w < count; w++)
+        {
+            if (lengths[w] <= MAX_WORD_LENGTH)
+            {
+                lookups[lookupCount++] = words[w];
+            }
+        }
+        frozenMapGetBatch(dictionary, lookups, lookupCount, values);
+        int lookup = 0;
+        for (int w = 0; w < count; w++)
+        {
+            if (lengths[w] > MAX_WORD_LENGTH || values[lookup++] == NULL)
+            {
+                handler(words[w], offsets[w], context);
+            }
+        }
+        checked += count;
+
+        // Keep the unfinished word; a word longer than the whole buffer makes
+        // it grow.
+        memmove(buffer, buffer + next, length - next);
+        bufferOffset += next;
+        length -= next;
+        if (length == capacity)
+        {
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+            lowered = realloc(lowered, capacity + 1);
+        }
+    }
+
+    int failed = ferror(input);
+    free(values);
+    free(lookups);
+    free(lengths);
+    free(offsets);
+    free(words);
+    free(lowered);
+    free(buffer);
+    return failed ? -1 : checked;
+}
@@ -0,0 +1,24 @@
+#ifndef DOCUMENT_CHECKER_H
+#define DOCUMENT_CHECKER_H
+
+/*
+ * Spell checks whole documents. Text is read from a stream in large blocks,
+ * split into words with the same rules as the dictionary loader, and the
+ * words of each block are looked up in the dictionary together.
+ */
+
+#include "frozenMap.h"
+#include <stdio.h>
+
+/**
+ * Called for every word not in the dictionary, in document order.
+ * @param word The word as looked up, in lowercase.
+ * @param offset Byte offset of the word in the document.
+ * @param context The context given to checkDocument.
+ */
+typedef void (*MisspellingHandler)(const char* word, long long offset, void* context);
+
+long long checkDocument(FILE* input, const FrozenMap* dictionary,
+                        MisspellingHandler handler, void* context);
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * CS 261 Data Structures
+ * Edit distances between words.
+ *
+ * Words of up to 64 characters are compared with Myers' bit-parallel
+ * algorithm in Hyyro's formulation: one column of the dynamic programming
+ * table is kept as bit vectors of +1/-1 vertical differences and advanced
+ * with a few word operations per character. Longer words fall back to a
+ * banded table (Ukkonen) that only fills cells within the bound of the
+ * diagonal.
+ */
+
+#include "editDistance.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+// Required by Levenshtein calculation.
+#define MIN3(a, b, c) ((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
+
+/**
+ * Sets bit i of match[c] for every character c = word[i]. Only the entries of
+ * the word's characters are written.
+ */
+static void matchInit(uint64_t *match, const char *word, int length)
+{
+    for (int i = 0; i < length; i++)
+    {
+        match[(unsigned char)word[i]] = 0;
+    }
+    for (int i = 0; i < length; i++)
+    {
+        match[(unsigned char)word[i]] |= 1ull << i;
+    }
+}
+
+/**
+ * Bit-parallel Levenshtein distance.
+ * @param match Match masks of the pattern, set by matchInit, for every
+ * character of the text.
+ * @param patternLength Length of the pattern, 1 to 64 characters.
+ * @param text
+ * @param textLength
+ * @param maxDistance
+ * @return Distance, or maxDistance + 1 once it must exceed maxDistance.
+ */
+static int levenshteinBitParallel(const uint64_t *match, int patternLength,
+                                  const char *text, int textLength,
+                                  int maxDistance)
+{
+    uint64_t positive = ~0ull;
+    uint64_t negative = 0;
+    uint64_t last = 1ull << (patternLength - 1);
+    int score = patternLength;
+    for (int j = 0; j < textLength; j++)
+    {
+        uint64_t equal = match[(unsigned char)text[j]];
+        uint64_t vertical = equal | negative;
+        uint64_t horizontal = (((equal & positive) + positive) ^ positive) | equal;
+        uint64_t horizontalPositive = negative | ~(horizontal | positive);
+        uint64_t horizontalNegative = positive & horizontal;
+
+        if (horizontalPositive & last)
+        {
+            score++;
+        }
+        else if (horizontalNegative & last)
+        {
+            score--;
+        }
+        // Each remaining character lowers the distance by at most one.
+        if (score - (textLength - j - 1) > maxDistance)
+        {
+            return maxDistance + 1;
+        }
+        // The first row of the table grows by one per character.
+        horizontalPositive = (horizontalPositive << 1) | 1;
+        horizontalNegative <<= 1;
+        positive = horizontalNegative | ~(vertical | horizontalPositive);
+        negative = horizontalPositive & vertical;
+    }
+    return score > maxDistance ? maxDistance + 1 : score;
+}
+
+/**
+ * Levenshtein distance filling only the cells within maxDistance of the
+ * diagonal, stopping once a whole row exceeds maxDistance. The row is on the
+ * heap, since the words can be any length.
+ * @return Distance, or maxDistance + 1 if it exceeds maxDistance.
+ */
+static int levenshteinBanded(const char *s1, int s1len, const char *s2, int s2len,
+                             int maxDistance)
+{
+    int outside = maxDistance + 1;
+    int *row = malloc(sizeof(int) * (s2len + 1));
+
+    for (int x = 0; x <= s2len; x++)
+    {
+        row[x] = x <= maxDistance ? x : outside;
+    }
+    for (int y = 1; y <= s1len; y++)
+    {
+        int from = y - maxDistance > 1 ? y - maxDistance : 1;
+        int to = y + maxDistance < s2len ? y + maxDistance : s2len;
+        int lastdiag = row[from - 1];
+        int best = outside;
+
+        // The cell left of the band is too far away to matter.
+        row[from - 1] = from == 1 && y <= maxDistance ? y : outside;
+        for (int x = from; x <= to; x++)
+        {
+            int olddiag = row[x];
+            int value = MIN3(row[x] + 1, row[x - 1] + 1, lastdiag + (s1[y - 1] == s2[x - 1] ? 0 : 1));
+            row[x] = value < outside ? value : outside;
+            best = row[x] < best ? row[x] : best;
+            lastdiag = olddiag;
+        }
+        if (to < s2len)
+        {
+            row[to + 1] = outside;
+        }
+        if (best > maxDistance)
+        {
+            free(row);
+            return outside;
+        }
+    }
+    int distance = row[s2len];
+    free(row);
+    return distance;
+}
+
+/**
+ * Compares two strings and calculates their Levenshtein distance, giving up
+ * once it is known to exceed maxDistance.
+ * @param s1
+ * @param s2
+ * @param maxDistance Largest distance of interest.
+ * @return Distance, or maxDistance + 1 if it is larger than maxDistance.
+ */
+int levenshteinBounded(const char *s1, const char *s2, int maxDistance)
+{
+    int s1len = strlen(s1);
+    int s2len = strlen(s2);
+
+    // Words can't be closer than their difference in length.
+    if (s1len - s2len > maxDistance || s2len - s1len > maxDistance)
+    {
+        return maxDistance + 1;
+    }
+    // Nor further apart than the longer one is long, so this bound loses
+    // nothing and keeps maxDistance + 1 from overflowing.
+    int longest = s1len > s2len ? s1len : s2len;
+    if (maxDistance > longest)
+    {
+        maxDistance = longest;
+    }
+    if (s1len > s2len)
+    {
+        const char *word = s1;
+        s1 = s2;
+        s2 = word;
+        s1len = s2len;
+        s2len = longest;
+    }
+    if (s1len == 0)
+    {
+        return s2len;
+    }
+    if (s1len <= 64)
+    {
+        // Characters only in s2 must match nothing.
+        uint64_t match[256];
+        for (int x = 0; x < s2len; x++)
+        {
+            match[(unsigned char)s2[x]] = 0;
+        }
+        matchInit(match, s1, s1len);
+        return levenshteinBitParallel(match, s1len, s2, s2len, maxDistance);
+    }
+    return levenshteinBanded(s1, s1len, s2, s2len, maxDistance);
+}
+
+/**
+ * Compares two strings and calculates their Leveinshtein distance.
+ */
+int levenshtein(const char *s1, const char *s2)
+{
+    return levenshteinBounded(s1, s2, INT_MAX);
+}
+
+/**
+ * Prepares a word to be compared with many others.
+ * @param pattern
+ * @param word Word to compare; it is not copied.
+ */
+void editPatternInit(EditPattern *pattern, const char *word)
+{
+    pattern->word = word;
+    pattern->length = strlen(word);
+    memset(pattern->match, 0, sizeof(pattern->match));
+    if (pattern->length <= 64)
+    {
+        matchInit(pattern->match, word, pattern->length);
+    }
+}
+
+/**
+ * Calculates the Levenshtein distance between a prepared word and another,
+ * giving up once it is known to exceed maxDistance.
+ * @param pattern Word prepared by editPatternInit.
+ * @param text
+ * @param maxDistance Largest distance of interest.
+ * @return Distance, or maxDistance + 1 if it is larger than maxDistance.
+ */
+int editPatternDistance(const EditPattern *pattern, const char *text, int maxDistance)
+{
+    int length = pattern->length;
+    int textLength = strlen(text);
+
+    if (length - textLength > maxDistance || textLength - length > maxDistance)
+    {
+        return maxDistance + 1;
+    }
+    int longest = length > textLength ? length : textLength;
+    if (maxDistance > longest)
+    {
+        maxDistance = longest;
+    }
+    if (length == 0 || textLength == 0)
+    {
+        return longest;
+    }
+    if (length <= 64)
+    {
+        return levenshteinBitParallel(pattern->match, length, text, textLength, maxDistance);
+    }
+    return levenshteinBanded(pattern->word, length, text, textLength, maxDistance);
+}
@@ -0,0 +1,37 @@
+#ifndef EDIT_DISTANCE_H
+#define EDIT_DISTANCE_H
+
+#include <stdint.h>
+
+/*
+ * Edit distances between words, used to suggest corrections. Bounded
+ * distances give up as soon as the result is known to exceed the bound, which
+ * is most of the work of a suggestion search.
+ */
+
+// Distance between two words, or any value above maxDistance once it is
+// known to be larger than maxDistance.
+typedef int (*EditDistance)(const char* s1, const char* s2, int maxDistance);
+
+// Levenshtein distance: insertions, deletions and substitutions.
+int levenshtein(const char* s1, const char* s2);
+// Levenshtein distance, or maxDistance + 1 if it is larger than maxDistance.
+int levenshteinBounded(const char* s1, const char* s2, int maxDistance);
+
+// A word prepared for comparison with many others: the masks of the bit-
+// parallel algorithm are built once instead of for every comparison.
+typedef struct EditPattern EditPattern;
+
+struct EditPattern
+{
+    const char* word;
+    int length;
+    // Bit i of match[c] is set if word[i] == c; words over 64 characters
+    // don't use it.
+    uint64_t match[256];
+};
+
+void editPatternInit(EditPattern* pattern, const char* word);
+int editPatternDistance(const EditPattern* pattern, const char* text, int maxDistance);
+
+#endif
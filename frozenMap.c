@@ -0,0 +1,726 @@
+/*
+ * CS 261 Data Structures
+ * Read-only maps with a minimal perfect hash.
+ *
+ * Keys are hashed into buckets of about FROZEN_BUCKET_SIZE keys. Largest
+ * buckets first, each bucket searches for a pilot: a number that, mixed into
+ * the hashes of its keys, sends all of them to entries no other key has taken
+ * (PTHash). A lookup hashes the key once, reads its bucket's pilot and
+ * compares the key in the one entry it can be in.
+ *
+ * A built map can be saved to a file and mapped back in place, so a program
+ * that queries the same keys on every run builds the map only once. The file
+ * is a header followed by the map's arrays; numbers are stored in native byte
+ * order, which the header records.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "frozenMap.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Average number of keys per bucket; larger buckets save pilot memory but
+// take longer to place.
+#define FROZEN_BUCKET_SIZE 3
+// Fraction of the pilot search table that is filled. Keys placed past the
+// last entry are moved to the holes left before it, so the map stays minimal;
+// the spare room makes the last buckets far quicker to place.
+#define FROZEN_LOAD 0.95
+// Pilots tried for one bucket before the seed is given up on.
+#define FROZEN_MAX_PILOT (1u << 16)
+// Seeds tried before building fails.
+#define FROZEN_SEEDS 16
+// Keys looked up together by frozenMapGetBatch.
+#define FROZEN_BATCH_BLOCK 256
+
+#define FROZEN_MAGIC "FROZENMP"
+#define FROZEN_VERSION 1
+#define FROZEN_BYTE_ORDER 0x01020304u
+
+typedef struct FrozenHeader FrozenHeader;
+
+// Header of a saved map. The arrays follow it in the order values,
+// keyOffsets, remap, pilots and keys, largest elements first, so each stays
+// aligned without padding.
+struct FrozenHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    // hashFunctionId of HASH_FUNCTION when the map was saved.
+    uint32_t hashId;
+    int32_t size;
+    int32_t bucketCount;
+    int32_t tableSize;
+    uint64_t seed;
+    uint64_t keysLength;
+    // hashFunctionWy of every byte after the header.
+    uint64_t checksum;
+};
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+/**
+ * Returns the bucket of a hash. Uses the high bits, which frozenEntry mixes
+ * with the pilot, so keys of one bucket still spread over every entry.
+ */
+static int frozenBucket(uint64_t hash, int bucketCount)
+{
+    return (int)(((hash >> 32) * (uint64_t)bucketCount) >> 32);
+}
+
+/**
+ * Returns the entry of a hash displaced by its bucket's pilot. The mixed hash
+ * is scaled to the table size with a multiply rather than a division, since
+ * building computes it for every pilot tried.
+ */
+static int frozenEntry(uint64_t hash, uint32_t pilot, int size)
+{
+    uint64_t mixed = hash ^ ((pilot + 1ull) * 0x9E3779B97F4A7C15ull);
+    mixed ^= mixed >> 33;
+    mixed *= 0xFF51AFD7ED558CCDull;
+    return (int)(((mixed >> 32) * (uint64_t)size) >> 32);
+}
+
+/**
+ * Searches a pilot for every bucket so that the keys land on distinct entries.
+ * @param hashes Hash of every key.
+ * @param size Number of keys.
+ * @param tableSize Number of places the keys are spread over.
+ * @param bucketCount
+ * @param pilots Set to the pilot of every bucket.
+ * @param entries Set to the entry of every key.
+ * @return 0 on success, or -1 if this seed doesn't work.
+ */
+static int findPilots(const uint64_t *hashes, int size, int tableSize,
+                      int bucketCount, uint16_t *pilots, int *entries)
+{
+    int *bucketStart = calloc(bucketCount + 1, sizeof(int));
+    int *members = malloc(sizeof(int) * size);
+    int *fill = malloc(sizeof(int) * bucketCount);
+    int maxBucketSize = 0;
+    int result = 0;
+
+    // Group the keys by bucket with a counting sort.
+    for (int i = 0; i < size; i++)
+    {
+        bucketStart[frozenBucket(hashes[i], bucketCount) + 1]++;
+    }
+    for (int b = 0; b < bucketCount; b++)
+    {
+        if (bucketStart[b + 1] > maxBucketSize)
+        {
+            maxBucketSize = bucketStart[b + 1];
+        }
+        bucketStart[b + 1] += bucketStart[b];
+        fill[b] = bucketStart[b];
+    }
+    for (int i = 0; i < size; i++)
+    {
+        members[fill[frozenBucket(hashes[i], bucketCount)]++] = i;
+    }
+
+    // Order the buckets by size, largest first, with a second counting sort.
+    int *sizeStart = calloc(maxBucketSize + 2, sizeof(int));
+    int *order = fill;
+    for (int b = 0; b < bucketCount; b++)
+    {
+        sizeStart[maxBucketSize - (bucketStart[b + 1] - bucketStart[b]) + 1]++;
+    }
+    for (int s = 0; s <= maxBucketSize; s++)
+    {
+        sizeStart[s + 1] += sizeStart[s];
+    }
+    for (int b = 0; b < bucketCount; b++)
+    {
+        order[sizeStart[maxBucketSize - (bucketStart[b + 1] - bucketStart[b])]++] = b;
+    }
+    free(sizeStart);
+
+    unsigned char *taken = calloc(tableSize, 1);
+    for (int o = 0; o < bucketCount && result == 0; o++)
+    {
+        int b = order[o];
+        int *bucket = members + bucketStart[b];
+        int count = bucketStart[b + 1] - bucketStart[b];
+
+        pilots[b] = 0;
+        // Keys with the same full hash can never be separated.
+        for (int i = 0; i < count && result == 0; i++)
+        {
+            for (int j = i + 1; j < count; j++)
+            {
+                if (hashes[bucket[i]] == hashes[bucket[j]])
+                {
+                    result = -1;
+                    break;
+                }
+            }
+        }
+        if (count == 0 || result != 0)
+        {
+            continue;
+        }
+
+        uint32_t pilot;
+        for (pilot = 0; pilot < FROZEN_MAX_PILOT; pilot++)
+        {
+            int placed = 0;
+            while (placed < count)
+            {
+                int entry = frozenEntry(hashes[bucket[placed]], pilot, tableSize);
+                if (taken[entry])
+                {
+                    break;
+                }
+                taken[entry] = 1;
+                entries[bucket[placed]] = entry;
+                placed++;
+            }
+            if (placed == count)
+            {
+                break;
+            }
+            while (placed > 0)
+            {
+                placed--;
+                taken[entries[bucket[placed]]] = 0;
+            }
+        }
+        if (pilot == FROZEN_MAX_PILOT)
+        {
+            result = -1;
+        }
+        pilots[b] = pilot;
+    }
+
+    free(taken);
+    free(order);
+    free(members);
+    free(bucketStart);
+    return result;
+}
+
+/**
+ * Builds a frozen map of distinct keys.
+ * @param keys
+ * @param values Value of each key.
+ * @param size Number of keys.
+ * @return The allocated map, or NULL if no seed gives a perfect hash.
+ */
+static FrozenMap *frozenMapBuild(const char **keys, const int *values, int size)
+{
+    FrozenMap *map = malloc(sizeof(FrozenMap));
+    uint64_t *hashes = malloc(sizeof(uint64_t) * size);
+    map->mapped = NULL;
+    map->mappedLength = 0;
+    int *entries = malloc(sizeof(int) * size);
+    size_t keysLength = 0;
+
+    for (int i = 0; i < size; i++)
+    {
+        keysLength += strlen(keys[i]) + 1;
+    }
+    assert(keysLength < UINT32_MAX);
+
+    map->size = size;
+    map->tableSize = (int)(size / FROZEN_LOAD);
+    if (map->tableSize < size)
+    {
+        map->tableSize = size;
+    }
+    map->bucketCount = (size + FROZEN_BUCKET_SIZE - 1) / FROZEN_BUCKET_SIZE;
+    map->pilots = malloc(sizeof(uint16_t) * map->bucketCount);
+    int found = 0;
+    for (int attempt = 0; attempt < FROZEN_SEEDS && !found; attempt++)
+    {
+        map->seed = HASH_SEED + attempt;
+        for (int i = 0; i < size; i++)
+        {
+            hashes[i] = HASH_FUNCTION(keys[i], strlen(keys[i]), map->seed);
+        }
+        found = findPilots(hashes, size, map->tableSize, map->bucketCount,
+                           map->pilots, entries) == 0;
+    }
+    free(hashes);
+    if (!found)
+    {
+        free(entries);
+        free(map->pilots);
+        free(map);
+        return NULL;
+    }
+
+    // Every key placed past the last entry fills one of the holes before it.
+    int *keyOfEntry = malloc(sizeof(int) * map->tableSize);
+    memset(keyOfEntry, -1, sizeof(int) * map->tableSize);
+    for (int i = 0; i < size; i++)
+    {
+        keyOfEntry[entries[i]] = i;
+    }
+    map->remap = calloc(map->tableSize - size + 1, sizeof(uint32_t));
+    int hole = 0;
+    for (int place = size; place < map->tableSize; place++)
+    {
+        if (keyOfEntry[place] < 0)
+        {
+            continue;
+        }
+        while (keyOfEntry[hole] >= 0)
+        {
+            hole++;
+        }
+        keyOfEntry[hole] = keyOfEntry[place];
+        map->remap[place - size] = hole;
+    }
+
+    // Store the keys in entry order, so visiting the entries in order reads
+    // the keys front to back.
+    map->keyOffsets = malloc(sizeof(uint32_t) * size);
+    map->values = malloc(sizeof(int) * size);
+    map->keys = malloc(keysLength);
+    map->keysLength = keysLength;
+    size_t offset = 0;
+    for (int entry = 0; entry < size; entry++)
+    {
+        int i = keyOfEntry[entry];
+        size_t length = strlen(keys[i]) + 1;
+        memcpy(map->keys + offset, keys[i], length);
+        map->keyOffsets[entry] = (uint32_t)offset;
+        map->values[entry] = values[i];
+        offset += length;
+    }
+    free(keyOfEntry);
+    free(entries);
+    return map;
+}
+
+/**
+ * Creates a frozen map with a copy of every key and value of a hash map. The
+ * hash map is not changed and may be deleted afterwards. Frozen keys are null
+ * terminated strings, so keys put with an explicit length must not contain
+ * zero bytes.
+ * @param map
+ * @return The allocated frozen map, or NULL if it can't be built.
+ */
+FrozenMap *frozenMapNew(HashMap *map)
+{
+    assert(map != 0);
+
+    int size = hashMapSize(map);
+    const char **keys = malloc(sizeof(char *) * size);
+    int *values = malloc(sizeof(int) * size);
+    HashMapIterator iterator;
+    const char *key;
+    int *value;
+    int i = 0;
+
+    hashMapIteratorInit(&iterator, map);
+    while (hashMapIteratorNext(&iterator, &key, &value))
+    {
+        assert(strlen(key) == (size_t)iterator.keyLength);
+        keys[i] = key;
+        values[i] = *value;
+        i++;
+    }
+    assert(i == size);
+
+    FrozenMap *frozen = frozenMapBuild(keys, values, size);
+    free(values);
+    free(keys);
+    return frozen;
+}
+
+/**
+ * Creates a frozen map of a list of words, all with the same value. Repeated
+ * words are stored once.
+ * @param words
+ * @param count Number of words in the list.
+ * @param value
+ * @return The allocated frozen map, or NULL if it can't be built.
+ */
+FrozenMap *frozenMapNewWords(const char **words, int count, int value)
+{
+    HashMap *distinct = hashMapNewEngine(count, HASH_MAP_GROUP_PROBING);
+    hashMapSetBorrowedKeys(distinct, 1);
+    hashMapPutBatch(distinct, words, count, value);
+    FrozenMap *frozen = frozenMapNew(distinct);
+    hashMapDelete(distinct);
+    return frozen;
+}
+
+/**
+ * Frees all memory of a frozen map, including the map itself.
+ * @param map
+ */
+void frozenMapDelete(FrozenMap *map)
+{
+    if (map->mapped != NULL)
+    {
+        munmap(map->mapped, map->mappedLength);
+        free(map);
+        return;
+    }
+    free(map->pilots);
+    free(map->remap);
+    free(map->keyOffsets);
+    free(map->values);
+    free(map->keys);
+    free(map);
+}
+
+/**
+ * Returns the number of places remapped to entries, one more than needed so
+ * that an empty map still has an array.
+ */
+static size_t frozenRemapCount(int size, int tableSize)
+{
+    return (size_t)(tableSize - size) + 1;
+}
+
+/**
+ * Returns the bytes of the arrays of a map, which follow the header of its
+ * file.
+ */
+static size_t frozenPayloadLength(int size, int bucketCount, int tableSize, size_t keysLength)
+{
+    return sizeof(int) * size + sizeof(uint32_t) * size +
+           sizeof(uint32_t) * frozenRemapCount(size, tableSize) +
+           sizeof(uint16_t) * bucketCount + keysLength;
+}
+
+/**
+ * Writes a frozen map to a file, which frozenMapLoad can map back in without
+ * building it again.
+ * @param map
+ * @param path
+ * @return 0 on success, -1 if the file can't be written.
+ */
+int frozenMapSave(const FrozenMap *map, const char *path)
+{
+    assert(map != 0);
+    assert(path != 0);
+
+    size_t remapCount = frozenRemapCount(map->size, map->tableSize);
+    size_t payloadLength = frozenPayloadLength(map->size, map->bucketCount, map->tableSize,
+                                               map->keysLength);
+    char *payload = malloc(payloadLength);
+    char *next = payload;
+
+    memcpy(next, map->values, sizeof(int) * map->size);
+    next += sizeof(int) * map->size;
+    memcpy(next, map->keyOffsets, sizeof(uint32_t) * map->size);
+    next += sizeof(uint32_t) * map->size;
+    memcpy(next, map->remap, sizeof(uint32_t) * remapCount);
+    next += sizeof(uint32_t) * remapCount;
+    memcpy(next, map->pilots, sizeof(uint16_t) * map->bucketCount);
+    next += sizeof(uint16_t) * map->bucketCount;
+    memcpy(next, map->keys, map->keysLength);
+
+    FrozenHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FROZEN_MAGIC, sizeof(header.magic));
+    header.version = FROZEN_VERSION;
+    header.byteOrder = FROZEN_BYTE_ORDER;
+    header.hashId = hashFunctionId(HASH_FUNCTION);
+    header.size = map->size;
+    header.bucketCount = map->bucketCount;
+    header.tableSize = map->tableSize;
+    header.seed = map->seed;
+    header.keysLength = map->keysLength;
+    header.checksum = hashFunctionWy(payload, payloadLength, 0);
+
+    FILE *file = fopen(path, "wb");
+    int result = -1;
+    if (file != NULL)
+    {
+        if (fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(payload, 1, payloadLength, file) == payloadLength)
+        {
+            result = 0;
+        }
+        if (fclose(file) != 0)
+        {
+            result = -1;
+        }
+    }
+    free(payload);
+    return result;
+}
+
+/**
+ * Points the arrays of a map into the payload of a mapped file and checks
+ * that the file is complete, uncorrupted and readable by this build.
+ * @return 1 if the map can be queried, 0 otherwise.
+ */
+static int frozenMapView(FrozenMap *map, char *data, size_t length)
+{
+    const FrozenHeader *header = (const FrozenHeader *)data;
+
+    if (length < sizeof(FrozenHeader) ||
+        memcmp(header->magic, FROZEN_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != FROZEN_VERSION || header->byteOrder != FROZEN_BYTE_ORDER ||
+        (int)header->hashId != hashFunctionId(HASH_FUNCTION))
+    {
+        return 0;
+    }
+    // The shape must be the one frozenMapBuild gives the size.
+    int size = header->size;
+    int tableSize = (int)(size / FROZEN_LOAD);
+    if (size < 0 || size > (1 << 30) || header->keysLength > UINT32_MAX ||
+        header->bucketCount != (size + FROZEN_BUCKET_SIZE - 1) / FROZEN_BUCKET_SIZE ||
+        header->tableSize != (tableSize < size ? size : tableSize) ||
+        length - sizeof(FrozenHeader) !=
+            frozenPayloadLength(size, header->bucketCount, header->tableSize,
+                                header->keysLength))
+    {
+        return 0;
+    }
+    if (hashFunctionWy(data + sizeof(FrozenHeader), length - sizeof(FrozenHeader), 0) !=
+        header->checksum)
+    {
+        return 0;
+    }
+
+    char *next = data + sizeof(FrozenHeader);
+    map->seed = header->seed;
+    map->size = size;
+    map->bucketCount = header->bucketCount;
+    map->tableSize = header->tableSize;
+    map->keysLength = header->keysLength;
+    map->values = (int *)next;
+    next += sizeof(int) * size;
+    map->keyOffsets = (uint32_t *)next;
+    next += sizeof(uint32_t) * size;
+    map->remap = (uint32_t *)next;
+    next += sizeof(uint32_t) * frozenRemapCount(size, map->tableSize);
+    map->pilots = (uint16_t *)next;
+    next += sizeof(uint16_t) * map->bucketCount;
+    map->keys = next;
+
+    // Every key must end inside the key bytes, and every place past the
+    // entries must lead back to an entry.
+    if (size > 0 && map->keys[map->keysLength - 1] != '\0')
+    {
+        return 0;
+    }
+    for (int entry = 0; entry < size; entry++)
+    {
+        if (map->keyOffsets[entry] >= map->keysLength)
+        {
+            return 0;
+        }
+    }
+    for (int place = size; place < map->tableSize; place++)
+    {
+        if (map->remap[place - size] >= (uint32_t)size)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Maps a frozen map saved by frozenMapSave. Queries read the mapped file in
+ * place; nothing is built, hashed or copied.
+ * @param path
+ * @return The map, or NULL if the file is missing, corrupt or from an
+ *         incompatible build.
+ */
+FrozenMap *frozenMapLoad(const char *path)
+{
+    assert(path != 0);
+
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(FrozenHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t length = info.st_size;
+    char *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    FrozenMap *map = malloc(sizeof(FrozenMap));
+    if (!frozenMapView(map, data, length))
+    {
+        munmap(data, length);
+        free(map);
+        return NULL;
+    }
+    map->mapped = data;
+    map->mappedLength = length;
+    return map;
+}
+
+/**
+ * Returns the entry a hash leads to, the only one its key can be in.
+ */
+static int frozenMapEntryOf(const FrozenMap *map, uint64_t hash)
+{
+    uint16_t pilot = map->pilots[frozenBucket(hash, map->bucketCount)];
+    int entry = frozenEntry(hash, pilot, map->tableSize);
+    if (entry >= map->size)
+    {
+        entry = map->remap[entry - map->size];
+    }
+    return entry;
+}
+
+/**
+ * Returns a pointer to the value of an entry if it holds the given key, or
+ * NULL.
+ */
+static const int *frozenMapGetEntry(const FrozenMap *map, const char *key, int entry)
+{
+    if (strcmp(map->keys + map->keyOffsets[entry], key) != 0)
+    {
+        return NULL;
+    }
+    return &map->values[entry];
+}
+
+/**
+ * Returns a pointer to the value of the given key, or NULL if the key is not
+ * in the map.
+ * @param map
+ * @param key
+ * @return Link value or NULL if no matching link.
+ */
+const int *frozenMapGet(const FrozenMap *map, const char *key)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    if (map->size == 0)
+    {
+        return NULL;
+    }
+    uint64_t hash = HASH_FUNCTION(key, strlen(key), map->seed);
+    return frozenMapGetEntry(map, key, frozenMapEntryOf(map, hash));
+}
+
+/**
+ * Looks up every key of an array, as if by frozenMapGet. A lookup reads a
+ * pilot, then the key's offset, then the key, each depending on the last, so
+ * a block of keys goes through those steps together and each pass prefetches
+ * what the next one reads for every key of the block.
+ * @param map
+ * @param keys
+ * @param count Number of keys.
+ * @param values Set to a pointer to each key's value, or NULL if the key is
+ * not in the map.
+ * @return Number of keys found.
+ */
+int frozenMapGetBatch(const FrozenMap *map, const char **keys, int count, const int **values)
+{
+    assert(map != 0);
+    assert(count == 0 || (keys != 0 && values != 0));
+
+    uint64_t hashes[FROZEN_BATCH_BLOCK];
+    int entries[FROZEN_BATCH_BLOCK];
+    int found = 0;
+
+    if (map->size == 0)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            values[i] = NULL;
+        }
+        return 0;
+    }
+    for (int start = 0; start < count; start += FROZEN_BATCH_BLOCK)
+    {
+        int blockSize = count - start < FROZEN_BATCH_BLOCK ? count - start : FROZEN_BATCH_BLOCK;
+        const char **block = keys + start;
+
+        for (int i = 0; i < blockSize; i++)
+        {
+            hashes[i] = HASH_FUNCTION(block[i], strlen(block[i]), map->seed);
+            PREFETCH(&map->pilots[frozenBucket(hashes[i], map->bucketCount)]);
+        }
+        for (int i = 0; i < blockSize; i++)
+        {
+            entries[i] = frozenMapEntryOf(map, hashes[i]);
+            PREFETCH(&map->keyOffsets[entries[i]]);
+        }
+        for (int i = 0; i < blockSize; i++)
+        {
+            PREFETCH(map->keys + map->keyOffsets[entries[i]]);
+        }
+        for (int i = 0; i < blockSize; i++)
+        {
+            values[start + i] = frozenMapGetEntry(map, block[i], entries[i]);
+            found += values[start + i] != NULL;
+        }
+    }
+    return found;
+}
+
+/**
+ * Returns 1 if the given key is in the map and 0 otherwise.
+ * @param map
+ * @param key
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int frozenMapContainsKey(const FrozenMap *map, const char *key)
+{
+    return frozenMapGet(map, key) != NULL;
+}
+
+/**
+ * Returns the number of keys in the map.
+ * @param map
+ * @return Number of keys.
+ */
+int frozenMapSize(const FrozenMap *map)
+{
+    assert(map != 0);
+    return map->size;
+}
+
+/**
+ * Returns the key of an entry.
+ * @param map
+ * @param index Entry index, from 0 to frozenMapSize - 1.
+ * @return Null terminated key owned by the map.
+ */
+const char *frozenMapKey(const FrozenMap *map, int index)
+{
+    assert(index >= 0 && index < map->size);
+    return map->keys + map->keyOffsets[index];
+}
+
+/**
+ * Returns a pointer to the value of an entry.
+ * @param map
+ * @param index Entry index, from 0 to frozenMapSize - 1.
+ * @return Pointer to the value.
+ */
+const int *frozenMapValue(const FrozenMap *map, int index)
+{
+    assert(index >= 0 && index < map->size);
+    return &map->values[index];
+}
@@ -0,0 +1,55 @@
+#ifndef FROZEN_MAP_H
+#define FROZEN_MAP_H
+
+/*
+ * Read-only map built once from a finished HashMap (or a list of words) with
+ * a minimal perfect hash: every key has its own entry, found with exactly one
+ * probe and no chains or empty slots. Nothing changes after it is built, so
+ * any number of threads may query one map at once. A map saved with
+ * frozenMapSave loads back with frozenMapLoad without being built again.
+ */
+
+#include "hashMap.h"
+
+typedef struct FrozenMap FrozenMap;
+
+struct FrozenMap
+{
+    // Seed of HASH_FUNCTION the pilots were searched with.
+    uint64_t seed;
+    // Number of keys, which is also the number of entries.
+    int size;
+    // Keys are split into buckets; each bucket has one pilot that moves all of
+    // its keys to free entries.
+    int bucketCount;
+    uint16_t* pilots;
+    // Pilots place keys among tableSize >= size places; places from size on
+    // are redirected to an entry by remap.
+    int tableSize;
+    uint32_t* remap;
+    // Offset of each entry's null terminated key in keys.
+    uint32_t* keyOffsets;
+    int* values;
+    // Every key, stored in entry order.
+    char* keys;
+    size_t keysLength;
+    // File the arrays point into if the map was loaded, or NULL.
+    void* mapped;
+    size_t mappedLength;
+};
+
+FrozenMap* frozenMapNew(HashMap* map);
+FrozenMap* frozenMapNewWords(const char** words, int count, int value);
+void frozenMapDelete(FrozenMap* map);
+int frozenMapSave(const FrozenMap* map, const char* path);
+FrozenMap* frozenMapLoad(const char* path);
+const int* frozenMapGet(const FrozenMap* map, const char* key);
+int frozenMapGetBatch(const FrozenMap* map, const char** keys, int count, const int** values);
+int frozenMapContainsKey(const FrozenMap* map, const char* key);
+int frozenMapSize(const FrozenMap* map);
+
+// Entries are dense, so they are visited with an index from 0 to size - 1.
+const char* frozenMapKey(const FrozenMap* map, int index);
+const int* frozenMapValue(const FrozenMap* map, int index);
+
+#endif
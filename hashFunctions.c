@@ -0,0 +1,190 @@
+/*
+ * CS 261 Data Structures
+ * Hash functions for the hash map.
+ */
+
+#include "hashFunctions.h"
+#include <string.h>
+
+uint64_t hashFunctionLegacy1(const void *key, size_t length, uint64_t seed)
+{
+    const char *bytes = key;
+    int r = (int)seed;
+    for (size_t i = 0; i < length; i++)
+    {
+        r += bytes[i];
+    }
+    return (unsigned int)r;
+}
+
+uint64_t hashFunctionLegacy2(const void *key, size_t length, uint64_t seed)
+{
+    const char *bytes = key;
+    int r = (int)seed;
+    for (size_t i = 0; i < length; i++)
+    {
+        r += (int)(i + 1) * bytes[i];
+    }
+    return (unsigned int)r;
+}
+
+uint64_t hashFunctionFnv1a(const void *key, size_t length, uint64_t seed)
+{
+    const unsigned char *bytes = key;
+    uint64_t h = 0xCBF29CE484222325ull ^ seed;
+    for (size_t i = 0; i < length; i++)
+    {
+        h ^= bytes[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+// --- Built-in function ids ---
+
+// Ids are positions in this array; only append to it.
+static const HashFunction builtinFunctions[] = {
+    hashFunctionLegacy1,
+    hashFunctionLegacy2,
+    hashFunctionFnv1a,
+    hashFunctionWy
+};
+
+#define BUILTIN_COUNT (int)(sizeof(builtinFunctions) / sizeof(builtinFunctions[0]))
+
+/**
+ * Returns the id of a built-in hash function, or -1 for any other function.
+ */
+int hashFunctionId(HashFunction hashFunction)
+{
+    for (int i = 0; i < BUILTIN_COUNT; i++)
+    {
+        if (builtinFunctions[i] == hashFunction)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns the built-in hash function with the given id, or NULL.
+ */
+HashFunction hashFunctionById(int id)
+{
+    if (id < 0 || id >= BUILTIN_COUNT)
+    {
+        return NULL;
+    }
+    return builtinFunctions[id];
+}
+
+// --- wyhash ---
+
+static const uint64_t wySecret[4] = {
+    0x2D358DCCAA6C78A5ull, 0x8BB84B93962EACC9ull,
+    0x4B33A62ED433D4A3ull, 0x4D5A2DA51DE1AA47ull
+};
+
+/**
+ * Multiplies a and b into a 128-bit product, leaving the low half in a and the
+ * high half in b.
+ */
+static void wyMultiply(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), carry = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    carry += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+static uint64_t wyMix(uint64_t a, uint64_t b)
+{
+    wyMultiply(&a, &b);
+    return a ^ b;
+}
+
+static uint64_t wyRead8(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t wyRead4(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint64_t wyRead3(const unsigned char *p, size_t k)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+uint64_t hashFunctionWy(const void *key, size_t length, uint64_t seed)
+{
+    const unsigned char *p = key;
+    uint64_t a, b;
+
+    seed ^= wyMix(seed ^ wySecret[0], wySecret[1]);
+    if (length <= 16)
+    {
+        if (length >= 4)
+        {
+            a = (wyRead4(p) << 32) | wyRead4(p + ((length >> 3) << 2));
+            b = (wyRead4(p + length - 4) << 32) |
+                wyRead4(p + length - 4 - ((length >> 3) << 2));
+        }
+        else if (length > 0)
+        {
+            a = wyRead3(p, length);
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        size_t i = length;
+        if (i > 48)
+        {
+            uint64_t see1 = seed, see2 = seed;
+            do
+            {
+                seed = wyMix(wyRead8(p) ^ wySecret[1], wyRead8(p + 8) ^ seed);
+                see1 = wyMix(wyRead8(p + 16) ^ wySecret[2], wyRead8(p + 24) ^ see1);
+                see2 = wyMix(wyRead8(p + 32) ^ wySecret[3], wyRead8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16)
+        {
+            seed = wyMix(wyRead8(p) ^ wySecret[1], wyRead8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wyRead8(p + i - 16);
+        b = wyRead8(p + i - 8);
+    }
+    a ^= wySecret[1];
+    b ^= seed;
+    wyMultiply(&a, &b);
+    return wyMix(a ^ wySecret[0] ^ length, b ^ wySecret[1]);
+}
@@ -0,0 +1,26 @@
+#ifndef HASH_FUNCTIONS_H
+#define HASH_FUNCTIONS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hash functions over an explicit byte range. Every function mixes in a seed,
+ * so maps can be randomized against crafted keys.
+ */
+typedef uint64_t (*HashFunction)(const void* key, size_t length, uint64_t seed);
+
+// Sum of the characters. Anagrams always collide; kept for comparison.
+uint64_t hashFunctionLegacy1(const void* key, size_t length, uint64_t seed);
+// Sum of the characters weighted by position; kept for comparison.
+uint64_t hashFunctionLegacy2(const void* key, size_t length, uint64_t seed);
+// 64-bit FNV-1a, one multiply per byte.
+uint64_t hashFunctionFnv1a(const void* key, size_t length, uint64_t seed);
+// wyhash (final version 4), reading 4 to 16 bytes at a time.
+uint64_t hashFunctionWy(const void* key, size_t length, uint64_t seed);
+
+// Built-in functions by a stable id, for formats that store hashes.
+int hashFunctionId(HashFunction hashFunction);
+HashFunction hashFunctionById(int id);
+
+#endif
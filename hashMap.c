@@ -6,246 +6,1625 @@
  */
 
 #include "hashMap.h"
+#include "hashMapSnapshot.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
 
-int hashFunction1(const char *key)
+// Links allocated together in one slab of a map's link pool.
+#define LINKS_PER_SLAB 1024
+// Bytes of key strings allocated together in a map's key arena.
+#define KEY_ARENA_BLOCK (64 * 1024)
+// Keys hashed together by hashMapPutBatch before they are inserted.
+#define BATCH_BLOCK 256
+// How many keys ahead of the current one a batch prefetches.
+#define PREFETCH_DISTANCE 8
+
+// Buckets of the chain length histogram written by hashMapPrintStatsJson.
+#define STATS_HISTOGRAM_LENGTH 64
+
+// Adds to a counter. Lookups only read the map, so several threads may
+// count at once, and the counters are updated atomically.
+#if defined(__GNUC__)
+#define STATS_COUNT(counter, amount) __atomic_fetch_add(&(counter), (amount), __ATOMIC_RELAXED)
+#else
+#define STATS_COUNT(counter, amount) ((counter) += (amount))
+#endif
+
+// Adds to a counter of a map that keeps stats.
+#define STATS_ADD(map, field, amount)                 \
+    do                                                \
+    {                                                 \
+        if ((map)->stats != NULL)                     \
+        {                                             \
+            STATS_COUNT((map)->stats->field, amount); \
+        }                                             \
+    } while (0)
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+/**
+ * Hashes a key with the map's hash function and seed. Slots store the hash
+ * and mark empty slots with 0, so the hash is never 0.
+ * @param map
+ * @param key
+ * @return 64-bit hash.
+ */
+static uint64_t hashKey(const HashMap *map, const char *key, size_t length)
+{
+    return probeHash(map->hashFunction(key, length, map->seed));
+}
+
+/**
+ * Copies a key string into the map's key arena, unless the map borrows its
+ * keys.
+ * @param map
+ * @param key
+ * @return Copy of the key owned by the map, or the key itself.
+ */
+static char *keyCopy(HashMap *map, const char *key, size_t length)
 {
-    int r = 0;
-    for (int i = 0; key[i] != '\0'; i++)
+    if (map->borrowKeys)
     {
-        r += key[i];
+        return (char *)key;
     }
-    return r;
+    char *copy = arenaAlloc(&map->keyArena, length + 1);
+    memcpy(copy, key, length);
+    copy[length] = '\0';
+    return copy;
 }
 
-int hashFunction2(const char *key)
+/**
+ * Returns a key copied with keyCopy to the map's key arena for reuse.
+ * @param map
+ * @param key
+ */
+static void keyFree(HashMap *map, char *key, int length)
 {
-    int r = 0;
-    for (int i = 0; key[i] != '\0'; i++)
+    if (map->borrowKeys)
     {
-        r += (i + 1) * key[i];
+        return;
     }
-    return r;
+    arenaFree(&map->keyArena, key, length + 1);
 }
 
 /**
- * Creates a new hash table link with a copy of the key string.
+ * Creates a new hash table link with a copy of the key string. The link comes
+ * from the map's link pool and the key from its key arena.
+ * @param map
  * @param key Key string to copy in the link.
+ * @param hash The key's full hash, cached in the link.
  * @param value Value to set in the link.
  * @param next Pointer to set as the link's next.
- * @return Hash table link allocated on the heap.
+ * @return Hash table link owned by the map.
  */
-HashLink *hashLinkNew(const char *key, int value, HashLink *next)
+HashLink *hashLinkNew(HashMap *map, const char *key, size_t length, uint64_t hash,
+                      int value, HashLink *next)
 {
-    HashLink *link = malloc(sizeof(HashLink));
-    link->key = malloc(sizeof(char) * (strlen(key) + 1));
-    strcpy(link->key, key);
+    HashLink *link = poolAlloc(&map->linkPool);
+    link->key = keyCopy(map, key, length);
+    link->keyLength = (int)length;
+    link->hash = hash;
     link->value = value;
     link->next = next;
     return link;
 }
 
 /**
- * Free the allocated memory for a hash table link created with hashLinkNew.
+ * Returns a link created with hashLinkNew, and its key, to the map's pools.
+ * @param map
  * @param link
  */
-static void hashLinkDelete(HashLink *link)
+static void hashLinkDelete(HashMap *map, HashLink *link)
 {
-    free(link->key);
-    free(link);
+    keyFree(map, link->key, link->keyLength);
+    poolFree(&map->linkPool, link);
 }
 
 /**
- * Initializes a hash table map, allocating memory for a link pointer table with
- * the given number of buckets.
+ * Returns the smallest power of two that is at least n (and at least 2).
+ * @param n
+ * @return Power of two capacity.
+ */
+static int roundUpPowerOfTwo(int n)
+{
+    int capacity = 2;
+    while (capacity < n)
+    {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/**
+ * Scrambles a hash with a Fibonacci multiplier so that weak hash functions with
+ * small, clustered outputs still spread across the whole slot array.
+ * @param hash
+ * @return 64 bits of well mixed hash.
+ */
+static uint64_t mixHash(uint64_t hash)
+{
+    return hash * 0x9E3779B97F4A7C15ull;
+}
+
+/**
+ * Returns the index of the lowest set bit of a non-zero mask.
+ * @param mask
+ * @return Bit index.
+ */
+static int lowestBit(unsigned int mask)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int bit = 0;
+    while ((mask & 1) == 0)
+    {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+/**
+ * Records one search for a key in the stats of a map that keeps them. Finds
+ * count in local variables and call this once, so maps without stats only pay
+ * for one test per search.
+ * @param map
+ * @param probes Links, slots or groups visited.
+ * @param compares Keys compared in full.
+ */
+static void statsSearch(const HashMap *map, int probes, int compares)
+{
+    HashMapStats *stats = map->stats;
+    if (stats != NULL)
+    {
+        STATS_COUNT(stats->probes, probes);
+        STATS_COUNT(stats->compares, compares);
+#if defined(__GNUC__)
+        int longest = __atomic_load_n(&stats->maxProbes, __ATOMIC_RELAXED);
+        while (probes > longest &&
+               !__atomic_compare_exchange_n(&stats->maxProbes, &longest, probes, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+        }
+#else
+        if (probes > stats->maxProbes)
+        {
+            stats->maxProbes = probes;
+        }
+#endif
+    }
+}
+
+/**
+ * Returns the processor time if the map keeps stats, for timing a resize.
+ */
+static clock_t statsClock(const HashMap *map)
+{
+    return map->stats != NULL ? clock() : 0;
+}
+
+/**
+ * Adds the processor time since start to the resize time of a map that keeps
+ * stats. Only writers resize, so this needs no atomic update.
+ */
+static void statsResizeTime(const HashMap *map, clock_t start)
+{
+    if (map->stats != NULL)
+    {
+        map->stats->resizeSeconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+    }
+}
+
+// --- Linear probing engine ---
+
+/*
+ * The slots of a linear probing map are those of its ProbeTable, which
+ * places, finds and removes them. The map keeps its own copy of the table's
+ * slot pointer and capacity, which the rest of this file reads for every
+ * open addressing engine, and grows and shrinks the table itself so that
+ * resizes are counted in its stats.
+ */
+
+/**
+ * Compares the key of a slot whose hash matched with a key of the given
+ * length.
+ */
+static int hashSlotMatch(const ProbeSlot *slot, const void *key, size_t length)
+{
+    const HashSlot *hashSlot = (const HashSlot *)slot;
+    return hashSlot->keyLength == (int)length && memcmp(hashSlot->key, key, length) == 0;
+}
+
+/**
+ * Returns the index of the slot holding the given key, or -1 if the key is not
+ * in the table, and records the search in the map's stats.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @param hash The key's hash.
+ * @param freeIndex Set to the empty slot that ended a miss, or NULL.
+ * @return Slot index or -1.
+ */
+static int probeFind(const HashMap *map, const char *key, size_t length, uint64_t hash,
+                     int *freeIndex)
+{
+    ProbeSearch search;
+    int index = probeTableFind(&map->probe, hash, key, length, hashSlotMatch, &search);
+    statsSearch(map, search.probes, search.compares);
+    if (freeIndex != NULL)
+    {
+        *freeIndex = search.freeIndex;
+    }
+    return index;
+}
+
+/**
+ * Copies the slot pointer and capacity of the map's probe table after the
+ * table was allocated or resized.
+ * @param map A HASH_MAP_LINEAR_PROBING map.
+ */
+static void probeSync(HashMap *map)
+{
+    map->slots = (HashSlot *)map->probe.slots;
+    map->capacity = map->probe.capacity;
+}
+
+// --- Group probing engine ---
+
+/*
+ * Each slot has a one byte control tag in a separate array. Full slots store 7
+ * bits of the hash; the high bit marks empty and deleted slots. Slots form
+ * groups of GROUP_WIDTH whose tags are compared all at once, so a probe only
+ * touches a key when its tag matches.
+ */
+#define GROUP_WIDTH 16
+#define CONTROL_EMPTY 0x80
+#define CONTROL_DELETED 0xFE
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+/**
+ * Returns a bit mask of the control bytes in a group equal to the given tag.
+ */
+static unsigned int groupMatch(const unsigned char *control, unsigned char tag)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)control);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+}
+
+/**
+ * Returns a bit mask of the empty or deleted control bytes in a group.
+ */
+static unsigned int groupMatchFree(const unsigned char *control)
+{
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)control));
+}
+#else
+static unsigned int groupMatch(const unsigned char *control, unsigned char tag)
+{
+    unsigned int mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++)
+    {
+        mask |= (unsigned int)(control[i] == tag) << i;
+    }
+    return mask;
+}
+
+static unsigned int groupMatchFree(const unsigned char *control)
+{
+    unsigned int mask = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++)
+    {
+        mask |= (unsigned int)(control[i] >> 7) << i;
+    }
+    return mask;
+}
+#endif
+
+/**
+ * Returns the 7 bit control tag of a hash.
+ */
+static unsigned char groupTag(uint64_t hash)
+{
+    return (unsigned char)(mixHash(hash) >> 57);
+}
+
+/**
+ * Returns the first group of a hash's probe sequence.
+ */
+static int groupHome(const HashMap *map, uint64_t hash)
+{
+    return (int)(mixHash(hash) >> 32) & (map->capacity / GROUP_WIDTH - 1);
+}
+
+/**
+ * Returns the index of the slot holding the given key, or -1 if the key is not
+ * in the table. Groups are visited in triangular order, which reaches every
+ * group of a power of two table, and probing stops at a group with an empty
+ * slot.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @param hash The key's hash.
+ * @param freeIndex Set on a miss to the first empty or deleted slot passed,
+ * where groupFree would insert the key, or NULL.
+ * @return Slot index or -1.
+ */
+static int groupFind(const HashMap *map, const char *key, size_t length, uint64_t hash,
+                     int *freeIndex)
+{
+    int groupMask = map->capacity / GROUP_WIDTH - 1;
+    int group = groupHome(map, hash);
+    unsigned char tag = groupTag(hash);
+    int compares = 0;
+    int firstFree = -1;
+
+    for (int step = 1;; step++)
+    {
+        unsigned char *control = map->control + group * GROUP_WIDTH;
+        unsigned int matches = groupMatch(control, tag);
+        while (matches != 0)
+        {
+            int index = group * GROUP_WIDTH + lowestBit(matches);
+            HashSlot *slot = &map->slots[index];
+            if (slot->probe.hash == hash && slot->keyLength == (int)length)
+            {
+                compares++;
+                if (memcmp(slot->key, key, length) == 0)
+                {
+                    statsSearch(map, step, compares);
+                    return index;
+                }
+            }
+            matches &= matches - 1;
+        }
+        if (firstFree < 0)
+        {
+            unsigned int freeMask = groupMatchFree(control);
+            firstFree = freeMask != 0 ? group * GROUP_WIDTH + lowestBit(freeMask) : -1;
+        }
+        if (groupMatch(control, CONTROL_EMPTY) != 0)
+        {
+            statsSearch(map, step, compares);
+            if (freeIndex != NULL)
+            {
+                *freeIndex = firstFree;
+            }
+            return -1;
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+/**
+ * Fills the control tag of an empty or deleted slot with a hash's tag.
+ * @param map
+ * @param index
+ * @param hash
+ */
+static void groupClaim(HashMap *map, int index, uint64_t hash)
+{
+    if (map->control[index] == CONTROL_EMPTY)
+    {
+        map->growthLeft--;
+    }
+    map->control[index] = groupTag(hash);
+}
+
+/**
+ * Returns the first empty or deleted slot of a hash's probe sequence and
+ * claims it with the hash's tag. There must be an empty slot.
+ * @param map
+ * @param hash
+ * @return Slot index.
+ */
+static int groupFree(HashMap *map, uint64_t hash)
+{
+    int groupMask = map->capacity / GROUP_WIDTH - 1;
+    int group = groupHome(map, hash);
+
+    for (int step = 1;; step++)
+    {
+        unsigned int freeMask = groupMatchFree(map->control + group * GROUP_WIDTH);
+        if (freeMask != 0)
+        {
+            int index = group * GROUP_WIDTH + lowestBit(freeMask);
+            groupClaim(map, index, hash);
+            return index;
+        }
+        group = (group + step) & groupMask;
+    }
+}
+
+/**
+ * Empties the slot at the given index. The slot can go back to empty only if
+ * its group still has an empty slot, since then no probe sequence has ever
+ * continued past the group; otherwise it is marked deleted.
+ * @param map
+ * @param index Index of an occupied slot.
+ */
+static void groupErase(HashMap *map, int index)
+{
+    unsigned char *group = map->control + index / GROUP_WIDTH * GROUP_WIDTH;
+
+    if (groupMatch(group, CONTROL_EMPTY) != 0)
+    {
+        map->control[index] = CONTROL_EMPTY;
+        map->growthLeft++;
+    }
+    else
+    {
+        map->control[index] = CONTROL_DELETED;
+    }
+    map->slots[index].probe.hash = 0;
+}
+
+// --- Open addressing ---
+
+/**
+ * Allocates empty slots (and control tags) for an open addressing map.
  * @param map
- * @param capacity The number of table buckets.
+ * @param capacity The number of slots, a power of two.
  */
-void hashMapInit(HashMap *map, int capacity)
+static void slotsInit(HashMap *map, int capacity)
 {
+    if (map->engine == HASH_MAP_LINEAR_PROBING)
+    {
+        probeTableInit(&map->probe, 0, sizeof(HashSlot));
+        map->probe.maxLoad = map->maxLoad;
+        probeTableResize(&map->probe, capacity);
+        probeSync(map);
+        return;
+    }
     map->capacity = capacity;
-    map->size = 0;
-    map->table = malloc(sizeof(HashLink *) * capacity);
-    for (int i = 0; i < capacity; i++)
+    map->slots = calloc(capacity, sizeof(HashSlot));
+    if (map->engine == HASH_MAP_GROUP_PROBING)
+    {
+        map->control = malloc(capacity);
+        memset(map->control, CONTROL_EMPTY, capacity);
+        map->growthLeft = (int)(capacity * map->maxLoad);
+    }
+}
+
+/**
+ * Returns the index of the slot holding the given key, or -1. On a miss
+ * freeIndex, unless NULL, is set to the slot slotPlace would use.
+ */
+static int slotFind(const HashMap *map, const char *key, size_t length, uint64_t hash,
+                    int *freeIndex)
+{
+    if (map->engine == HASH_MAP_GROUP_PROBING)
+    {
+        return groupFind(map, key, length, hash, freeIndex);
+    }
+    return probeFind(map, key, length, hash, freeIndex);
+}
+
+/**
+ * Claims a free slot for a hash: the one at the given index, which a miss
+ * found, or the first of the hash's probe sequence if index is -1. There
+ * must be room for one more entry.
+ * @return Index of the claimed slot.
+ */
+static int slotClaim(HashMap *map, int index, uint64_t hash)
+{
+    if (map->engine == HASH_MAP_LINEAR_PROBING)
+    {
+        return (int)((HashSlot *)probeTableInsert(&map->probe, hash, index) - map->slots);
+    }
+    if (index < 0)
+    {
+        return groupFree(map, hash);
+    }
+    groupClaim(map, index, hash);
+    return index;
+}
+
+/**
+ * Stores an entry in the slot at the given index.
+ */
+static void slotStore(HashMap *map, int index, char *key, int length, uint64_t hash, int value)
+{
+    map->slots[index].probe.hash = hash;
+    map->slots[index].key = key;
+    map->slots[index].keyLength = length;
+    map->slots[index].value = value;
+}
+
+/**
+ * Stores an entry in a free slot of its probe sequence. The key must not
+ * already be in the table and there must be room for it. Only hashes and
+ * control tags are read, never keys.
+ * @param map
+ * @param key Key pointer to store; ownership passes to the table.
+ * @param length Bytes in the key.
+ * @param hash The key's hash.
+ * @param value
+ * @return Index of the slot used.
+ */
+static int slotPlace(HashMap *map, char *key, int length, uint64_t hash, int value)
+{
+    int index = slotClaim(map, -1, hash);
+    slotStore(map, index, key, length, hash, value);
+    return index;
+}
+
+/**
+ * Moves every entry of an open addressing table into a slot array of the given
+ * capacity. Entries are placed by their stored hash, so no key is rehashed or
+ * copied. This also clears deleted tags.
+ * @param map
+ * @param capacity The new number of slots, a power of two.
+ */
+static void slotsResize(HashMap *map, int capacity)
+{
+    int oldCapacity = map->capacity;
+    clock_t start = statsClock(map);
+
+    if (map->engine == HASH_MAP_LINEAR_PROBING)
+    {
+        probeTableResize(&map->probe, capacity);
+        probeSync(map);
+    }
+    else
+    {
+        HashSlot *oldSlots = map->slots;
+        unsigned char *oldControl = map->control;
+        slotsInit(map, capacity);
+        for (int i = 0; i < oldCapacity; i++)
+        {
+            if (oldSlots[i].probe.hash != 0)
+            {
+                slotPlace(map, oldSlots[i].key, oldSlots[i].keyLength, oldSlots[i].probe.hash,
+                          oldSlots[i].value);
+            }
+        }
+        free(oldSlots);
+        free(oldControl);
+    }
+    STATS_ADD(map, resizes, capacity != oldCapacity);
+    statsResizeTime(map, start);
+}
+
+/**
+ * Makes room for one more entry, growing the table by its growth factor if it
+ * is at its load limit. A group probing table whose room is taken up by
+ * deleted tags is rebuilt at the same capacity instead.
+ * @param map
+ * @return 1 if the table was rebuilt, moving every entry, 0 otherwise.
+ */
+static int slotsReserveOne(HashMap *map)
+{
+    if (map->engine == HASH_MAP_GROUP_PROBING)
+    {
+        if (map->growthLeft == 0)
+        {
+            int full = map->size + 1 > map->capacity * map->maxLoad / 2;
+            slotsResize(map, full ? map->capacity * map->growthFactor : map->capacity);
+            return 1;
+        }
+    }
+    else if (map->size + 1 > map->capacity * map->maxLoad)
+    {
+        slotsResize(map, map->capacity * map->growthFactor);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Removes the entry in the slot at the given index and frees its key.
+ */
+static void slotErase(HashMap *map, int index)
+{
+    keyFree(map, map->slots[index].key, map->slots[index].keyLength);
+    if (map->engine == HASH_MAP_GROUP_PROBING)
+    {
+        groupErase(map, index);
+    }
+    else
+    {
+        // The table never shrinks itself; shrinkAfterRemove shrinks the map.
+        probeTableErase(&map->probe, index);
+    }
+}
+
+// --- Chaining ---
+
+/**
+ * Returns the index of a hash's bucket in a chained table of the given
+ * capacity, a power of two. The hash is mixed first so that weak hash
+ * functions still use the high buckets.
+ */
+static int chainedHome(uint64_t hash, int capacity)
+{
+    return (int)(mixHash(hash) >> 32) & (capacity - 1);
+}
+
+/**
+ * Returns the bucket that holds (or would hold) a key with the given hash.
+ * While an incremental resize is in progress, buckets of the old table that
+ * have not been migrated yet are still authoritative.
+ * @param map
+ * @param hash
+ * @return Pointer to the head of the bucket's list.
+ */
+static HashLink **chainedBucket(const HashMap *map, uint64_t hash)
+{
+    if (map->oldTable != NULL)
+    {
+        int oldIndex = chainedHome(hash, map->oldCapacity);
+        if (oldIndex >= map->migrateIndex)
+        {
+            return &map->oldTable[oldIndex];
+        }
+    }
+    return &map->table[chainedHome(hash, map->capacity)];
+}
+
+/**
+ * Moves every link of a list to the head of its bucket in the map's current
+ * table, reusing the link and its cached hash.
+ * @param map
+ * @param current First link of the list.
+ */
+static void chainedRelink(HashMap *map, HashLink *current)
+{
+    while (current != NULL)
+    {
+        HashLink *nextLink = current->next;
+        int hashIndex = chainedHome(current->hash, map->capacity);
+        current->next = map->table[hashIndex];
+        map->table[hashIndex] = current;
+        current = nextLink;
+    }
+}
+
+/**
+ * Migrates up to the given number of buckets from the old table of an
+ * incremental resize, freeing the old table once it is empty.
+ * @param map
+ * @param count Number of buckets to migrate.
+ */
+static void chainedMigrate(HashMap *map, int count)
+{
+    clock_t start = statsClock(map);
+    while (count > 0 && map->migrateIndex < map->oldCapacity)
+    {
+        chainedRelink(map, map->oldTable[map->migrateIndex]);
+        map->oldTable[map->migrateIndex] = NULL;
+        map->migrateIndex++;
+        count--;
+    }
+    if (map->migrateIndex == map->oldCapacity)
+    {
+        free(map->oldTable);
+        map->oldTable = NULL;
+    }
+    statsResizeTime(map, start);
+}
+
+/**
+ * Returns the bucket at the given position, counting the buckets of the
+ * current table first and then those of an old table still being migrated.
+ */
+static HashLink *chainedBucketAt(const HashMap *map, int index)
+{
+    if (index < map->capacity)
+    {
+        return map->table[index];
+    }
+    return map->oldTable[index - map->capacity];
+}
+
+/**
+ * Returns the number of buckets visible to chainedBucketAt.
+ */
+static int chainedBucketCount(const HashMap *map)
+{
+    return map->capacity + (map->oldTable != NULL ? map->oldCapacity : 0);
+}
+
+/**
+ * Returns the link holding the given key, or NULL if the key is not in the
+ * table.
+ */
+static HashLink *chainedFind(const HashMap *map, const char *key, size_t length,
+                             uint64_t hash)
+{
+    struct HashLink *current = *chainedBucket(map, hash);
+    int probes = 0;
+    int compares = 0;
+
+    while (current != NULL)
+    {
+        probes++;
+        if (current->hash == hash && current->keyLength == (int)length)
+        {
+            compares++;
+            if (memcmp(current->key, key, length) == 0)
+            {
+                break;
+            }
+        }
+        current = current->next;
+    }
+    statsSearch(map, probes, compares);
+    return current;
+}
+
+/**
+ * Initializes a hash table map, allocating memory for a link pointer table or
+ * slot array with the given number of buckets.
+ * @param map
+ * @param capacity The number of table buckets, rounded up to a power of two.
+ * @param engine The table layout to use.
+ */
+void hashMapInit(HashMap *map, int capacity, HashMapEngine engine)
+{
+    map->engine = engine;
+    map->hashFunction = HASH_FUNCTION;
+    map->seed = HASH_SEED;
+    map->size = 0;
+    map->table = NULL;
+    map->oldTable = NULL;
+    map->resizeStep = 0;
+    map->borrowKeys = 0;
+    map->slots = NULL;
+    memset(&map->probe, 0, sizeof(map->probe));
+    map->control = NULL;
+    map->snapshot = NULL;
+    map->snapshotLength = 0;
+    map->stats = NULL;
+    map->minLoad = MIN_TABLE_LOAD;
+    map->growthFactor = GROWTH_FACTOR;
+    map->maxLoad = engine == HASH_MAP_GROUP_PROBING    ? MAX_GROUP_TABLE_LOAD
+                   : engine == HASH_MAP_LINEAR_PROBING ? MAX_PROBE_TABLE_LOAD
+                                                       : MAX_TABLE_LOAD;
+    poolInit(&map->linkPool, sizeof(HashLink), LINKS_PER_SLAB);
+    arenaInit(&map->keyArena, KEY_ARENA_BLOCK);
+    if (engine == HASH_MAP_SNAPSHOT)
+    {
+        // hashMapLoadSnapshot fills in the mapped table.
+        map->capacity = 0;
+        return;
+    }
+    if (engine == HASH_MAP_GROUP_PROBING)
+    {
+        slotsInit(map, roundUpPowerOfTwo(capacity < GROUP_WIDTH ? GROUP_WIDTH : capacity));
+        return;
+    }
+    if (engine == HASH_MAP_LINEAR_PROBING)
+    {
+        slotsInit(map, roundUpPowerOfTwo(capacity));
+        return;
+    }
+    map->capacity = roundUpPowerOfTwo(capacity);
+    map->table = calloc(map->capacity, sizeof(HashLink *));
+}
+
+/**
+ * Removes all links in the map and frees all allocated memory. Links and keys
+ * are released together with their pool and arena rather than one by one.
+ * @param map
+ */
+void hashMapCleanUp(HashMap *map)
+{
+    if (map->snapshot != NULL)
+    {
+        snapshotClose(map);
+    }
+    free(map->table);
+    free(map->oldTable);
+    if (map->engine == HASH_MAP_LINEAR_PROBING)
+    {
+        probeTableRelease(&map->probe);
+    }
+    else
+    {
+        free(map->slots);
+    }
+    free(map->control);
+    free(map->stats);
+    poolRelease(&map->linkPool);
+    arenaRelease(&map->keyArena);
+}
+
+/**
+ * Creates a hash table map, allocating memory for a link pointer table with
+ * the given number of buckets.
+ * @param capacity The number of buckets, rounded up to a power of two.
+ * @return The allocated map.
+ */
+HashMap *hashMapNew(int capacity)
+{
+    return hashMapNewEngine(capacity, HASH_MAP_CHAINED);
+}
+
+/**
+ * Creates a hash table map with the given table layout. Every engine rounds
+ * its capacity up to a power of two.
+ * @param capacity The number of buckets.
+ * @param engine The table layout to use.
+ * @return The allocated map.
+ */
+HashMap *hashMapNewEngine(int capacity, HashMapEngine engine)
+{
+    HashMap *map = malloc(sizeof(HashMap));
+    hashMapInit(map, capacity, engine);
+    return map;
+}
+
+/**
+ * Removes all links in the map and frees all allocated memory, including the
+ * map itself.
+ * @param map
+ */
+void hashMapDelete(HashMap *map)
+{
+    hashMapCleanUp(map);
+    free(map);
+}
+
+/**
+ * Returns the index of the slot of a HASH_MAP_SNAPSHOT map holding the given
+ * key, or -1, and records the search in the map's stats.
+ */
+static int snapshotSearch(const HashMap *map, const char *key, size_t length, uint64_t hash)
+{
+    int probes;
+    int compares;
+    int index = snapshotFind(map, key, length, hash, &probes, &compares);
+    statsSearch(map, probes, compares);
+    return index;
+}
+
+/**
+ * Returns a pointer to the value of the given key, or NULL, with the key
+ * already hashed.
+ */
+static int *getHashed(HashMap *map, const char *key, size_t length, uint64_t hash)
+{
+    hash = probeHash(hash);
+    STATS_ADD(map, lookups, 1);
+    if (map->engine == HASH_MAP_SNAPSHOT)
+    {
+        int index = snapshotSearch(map, key, length, hash);
+        return index < 0 ? NULL : snapshotValue(map, index);
+    }
+    if (map->engine != HASH_MAP_CHAINED)
+    {
+        int index = slotFind(map, key, length, hash, NULL);
+        return index < 0 ? NULL : &map->slots[index].value;
+    }
+
+    HashLink *link = chainedFind(map, key, length, hash);
+    return link != NULL ? &link->value : NULL;
+}
+
+/**
+ * Returns a pointer to the value of the link with the given key  and skip traversing as well. Returns NULL
+ * if no link with that key is in the table.
+ * 
+ * Use the map's hash function and capacity to find the index of the
+ * correct linked list bucket. Also make sure to search the entire list.
+ * 
+ * @param map
+ * @param key
+ * @return Link value or NULL if no matching link.
+ */
+int *hashMapGet(HashMap *map, const char *key)
+{
+    assert(key != 0);
+    return hashMapGetN(map, key, strlen(key));
+}
+
+/**
+ * Returns a pointer to the value of the given key of explicit length, or NULL
+ * if the key is not in the table. The key may hold any bytes, including zeros.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @return Link value or NULL if no matching link.
+ */
+int *hashMapGetN(HashMap *map, const void *key, size_t length)
+{
+    assert(map != 0);
+    assert(key != 0);
+    assert(length <= INT_MAX);
+
+    return getHashed(map, key, length, hashKey(map, key, length));
+}
+
+/**
+ * Returns the hash the map gives a key, for the *Hashed functions. A caller
+ * that needs the hash anyway, such as to pick one of several maps, can then
+ * pass it on instead of having the key hashed again.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @return 64-bit hash.
+ */
+uint64_t hashMapHash(const HashMap *map, const void *key, size_t length)
+{
+    assert(map != 0);
+    assert(key != 0);
+    return hashKey(map, key, length);
+}
+
+/**
+ * Like hashMapGetN, with the key's hash already computed by hashMapHash.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @param hash Hash of the key from hashMapHash.
+ * @return Link value or NULL if no matching link.
+ */
+int *hashMapGetHashed(HashMap *map, const void *key, size_t length, uint64_t hash)
+{
+    assert(map != 0);
+    assert(key != 0);
+    assert(length <= INT_MAX);
+
+    return getHashed(map, key, length, hash);
+}
+
+/**
+ * Resizes the hash table to have a number of buckets equal to the given
+ * capacity, a power of two. The existing links are relinked into
+ * the new table by their cached hash, so nothing is allocated or copied per
+ * link.
+ * 
+ * With incremental resizing on, the old table is kept and its buckets are
+ * migrated a few at a time by later puts and removes instead.
+ * 
+ * @param map
+ * @param capacity The new number of buckets.
+ */
+void resizeTable(HashMap *map, int capacity)
+{
+    hashMapFinishResize(map);
+
+    HashLink **oldTable = map->table;
+    int oldCapacity = map->capacity;
+    clock_t start = statsClock(map);
+
+    STATS_ADD(map, resizes, capacity != oldCapacity);
+    map->table = calloc(capacity, sizeof(HashLink *));
+    map->capacity = capacity;
+    if (map->resizeStep > 0)
+    {
+        map->oldTable = oldTable;
+        map->oldCapacity = oldCapacity;
+        map->migrateIndex = 0;
+        statsResizeTime(map, start);
+        return;
+    }
+    for (int i = 0; i < oldCapacity; i++)
+    {
+        chainedRelink(map, oldTable[i]);
+    }
+    free(oldTable);
+    statsResizeTime(map, start);
+}
+
+/**
+ * Completes an incremental resize in progress, if any.
+ * @param map
+ */
+void hashMapFinishResize(HashMap *map)
+{
+    assert(map != 0);
+    if (map->oldTable != NULL)
+    {
+        chainedMigrate(map, map->oldCapacity);
+    }
+}
+
+/**
+ * Turns incremental resizing of a chained map on or off. When on, a resize
+ * only allocates the new bucket array, and each later put or remove migrates
+ * the given number of old buckets, so no single operation pays for the whole
+ * table. Lookups check both tables until migration completes. Other engines
+ * ignore this setting.
+ * @param map
+ * @param bucketsPerStep Buckets to migrate per operation, or 0 to turn off.
+ */
+void hashMapSetIncrementalResize(HashMap *map, int bucketsPerStep)
+{
+    assert(map != 0);
+    assert(bucketsPerStep >= 0);
+    map->resizeStep = bucketsPerStep;
+    if (bucketsPerStep == 0)
+    {
+        hashMapFinishResize(map);
+    }
+}
+
+/**
+ * Switches the map to a different hash function and seed. Entries already in
+ * the table are rehashed into place.
+ * @param map
+ * @param hashFunction One of the hashFunctions.h functions or a custom one.
+ * @param seed Seed mixed into every hash.
+ */
+void hashMapSetHashFunction(HashMap *map, HashFunction hashFunction, uint64_t seed)
+{
+    assert(map != 0);
+    assert(hashFunction != 0);
+    assert(map->engine != HASH_MAP_SNAPSHOT);
+
+    map->hashFunction = hashFunction;
+    map->seed = seed;
+    if (map->engine == HASH_MAP_CHAINED)
+    {
+        HashMapIterator iterator;
+        const char *key;
+        int *value;
+
+        hashMapFinishResize(map);
+        hashMapIteratorInit(&iterator, map);
+        while (hashMapIteratorNext(&iterator, &key, &value))
+        {
+            iterator.link->hash = hashKey(map, key, iterator.keyLength);
+        }
+        resizeTable(map, map->capacity);
+        hashMapFinishResize(map);
+        return;
+    }
+    for (int i = 0, cap = map->capacity; i < cap; i++)
+    {
+        if (map->slots[i].probe.hash != 0)
+        {
+            map->slots[i].probe.hash = hashKey(map, map->slots[i].key,
+                                               map->slots[i].keyLength);
+        }
+    }
+    slotsResize(map, map->capacity);
+}
+
+/**
+ * Finds or creates the link for a key whose hash is already known.
+ * @see hashMapGetOrInsert
+ */
+static int *getOrInsertHashed(HashMap *map, const char *key, size_t length, uint64_t hash,
+                              int value, int *inserted)
+{
+    assert(map->engine != HASH_MAP_SNAPSHOT);
+
+    hash = probeHash(hash);
+    STATS_ADD(map, puts, 1);
+    if (map->engine != HASH_MAP_CHAINED)
+    {
+        int freeIndex;
+        int index = slotFind(map, key, length, hash, &freeIndex);
+        *inserted = index < 0;
+        if (index < 0)
+        {
+            STATS_ADD(map, inserts, 1);
+            char *copy = keyCopy(map, key, length);
+            // The miss already found the free slot, unless a resize moved
+            // everything.
+            index = slotClaim(map, slotsReserveOne(map) ? -1 : freeIndex, hash);
+            slotStore(map, index, copy, (int)length, hash, value);
+            map->size++;
+        }
+        return &map->slots[index].value;
+    }
+
+    if (map->oldTable != NULL)
+    {
+        chainedMigrate(map, map->resizeStep);
+    }
+
+    // Walk the bucket keeping a pointer to the last next pointer, so the
+    // new link can be appended where the walk ends.
+    HashLink **link = chainedBucket(map, hash);
+    int probes = 0;
+    int compares = 0;
+    while (*link != NULL)
+    {
+        probes++;
+        if ((*link)->hash == hash && (*link)->keyLength == (int)length)
+        {
+            compares++;
+            if (memcmp((*link)->key, key, length) == 0)
+            {
+                statsSearch(map, probes, compares);
+                *inserted = 0;
+                return &(*link)->value;
+            }
+        }
+        link = &(*link)->next;
+    }
+    statsSearch(map, probes, compares);
+    STATS_ADD(map, inserts, 1);
+
+    HashLink *newLink = hashLinkNew(map, key, length, hash, value, NULL);
+    *link = newLink;
+    *inserted = 1;
+    map->size++;
+    if (hashMapTableLoad(map) > map->maxLoad)
+    {
+        // Resizing relinks links in place, so newLink stays valid.
+        resizeTable(map, map->capacity * map->growthFactor);
+    }
+    return &newLink->value;
+}
+
+/**
+ * Makes the map store the key pointers it is given instead of copies. The
+ * caller must keep every key alive and unchanged until it is removed or the
+ * map is deleted; this lets keys live in a buffer such as a mapped file.
+ * Can only be changed while the map is empty.
+ * @param map
+ * @param borrowed 1 to borrow keys, 0 to copy them.
+ */
+void hashMapSetBorrowedKeys(HashMap *map, int borrowed)
+{
+    assert(map != 0);
+    assert(map->size == 0);
+    map->borrowKeys = borrowed;
+}
+
+/**
+ * Returns a pointer to the value of the link with the given key, creating the
+ * link with the given value first if the key is not in the table. The key is
+ * hashed once and its bucket (or probe sequence) walked once either way.
+ * 
+ * The pointer is valid until the map is next modified.
+ * 
+ * @param map
+ * @param key
+ * @param value Value of the link if it has to be created.
+ * @param inserted Set to 1 if the link was created, 0 if it existed. May be
+ *                 NULL.
+ * @return Pointer to the link's value.
+ */
+int *hashMapGetOrInsert(HashMap *map, const char *key, int value, int *inserted)
+{
+    assert(key != 0);
+    return hashMapGetOrInsertN(map, key, strlen(key), value, inserted);
+}
+
+/**
+ * Like hashMapGetOrInsert, for a key of explicit length that may hold any
+ * bytes. The map stores a copy of the key with a terminating zero added, so
+ * iterating still yields usable strings for text keys.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @param value Value of the link if it has to be created.
+ * @param inserted Set to 1 if the link was created, 0 if it existed. May be
+ *                 NULL.
+ * @return Pointer to the link's value.
+ */
+int *hashMapGetOrInsertN(HashMap *map, const void *key, size_t length, int value, int *inserted)
+{
+    assert(map != 0);
+    assert(key != 0);
+    assert(length <= INT_MAX);
+
+    return hashMapGetOrInsertHashed(map, key, length, hashKey(map, key, length), value,
+                                    inserted);
+}
+
+/**
+ * Like hashMapGetOrInsertN, with the key's hash already computed by
+ * hashMapHash.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @param hash Hash of the key from hashMapHash.
+ * @param value Value of the link if it has to be created.
+ * @param inserted Set to 1 if the link was created, 0 if it existed. May be
+ *                 NULL.
+ * @return Pointer to the link's value.
+ */
+int *hashMapGetOrInsertHashed(HashMap *map, const void *key, size_t length, uint64_t hash,
+                              int value, int *inserted)
+{
+    assert(map != 0);
+    assert(key != 0);
+    assert(length <= INT_MAX);
+
+    int dummy;
+    return getOrInsertHashed(map, key, length, hash, value,
+                             inserted != NULL ? inserted : &dummy);
+}
+
+/**
+ * Updates the given key-value pair in the hash table. If a link with the given
+ * key already exists, this will just update the value. Otherwise, it will
+ * create a new link with the given key and value and add it to the end of the
+ * table bucket's linked list. Either way the bucket is only walked once.
+ * 
+ * @param map
+ * @param key
+ * @param value
+ */
+void hashMapPut(HashMap *map, const char *key, int value)
+{
+    assert(key != 0);
+    hashMapPutN(map, key, strlen(key), value);
+}
+
+/**
+ * Updates the given key of explicit length with a value, adding the key if it
+ * is not in the table. The key may hold any bytes, including zeros.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @param value
+ */
+void hashMapPutN(HashMap *map, const void *key, size_t length, int value)
+{
+    int inserted;
+    int *slot = hashMapGetOrInsertN(map, key, length, value, &inserted);
+    if (!inserted)
+    {
+        *slot = value;
+    }
+}
+
+/**
+ * Returns the smallest capacity that holds the given number of entries within
+ * the given load, at least the engine's smallest table.
+ */
+static int fitCapacity(const HashMap *map, int count, double load)
+{
+    int capacity = probeCapacity(count, load);
+    if (map->engine == HASH_MAP_GROUP_PROBING && capacity < GROUP_WIDTH)
+    {
+        return GROUP_WIDTH;
+    }
+    return capacity;
+}
+
+/**
+ * Resizes the table to the given capacity with the engine's own resize.
+ */
+static void resizeTo(HashMap *map, int capacity)
+{
+    if (map->engine == HASH_MAP_CHAINED)
+    {
+        resizeTable(map, capacity);
+    }
+    else
+    {
+        slotsResize(map, capacity);
+    }
+}
+
+/**
+ * Grows the table, if needed, so that it can hold the given number of links
+ * without resizing.
+ * @param map
+ * @param count Number of links the table should hold.
+ */
+void hashMapReserve(HashMap *map, int count)
+{
+    assert(map != 0);
+    assert(map->engine != HASH_MAP_SNAPSHOT);
+
+    int capacity = fitCapacity(map, count, map->maxLoad);
+    if (capacity > map->capacity)
+    {
+        resizeTo(map, capacity);
+    }
+}
+
+/**
+ * Shrinks the table to the smallest capacity that holds its links, for
+ * example after removing most of them. This also clears the deleted tags of
+ * a group probing table.
+ * @param map
+ */
+void hashMapShrinkToFit(HashMap *map)
+{
+    assert(map != 0);
+    assert(map->engine != HASH_MAP_SNAPSHOT);
+
+    int capacity = fitCapacity(map, map->size, map->maxLoad);
+    if (capacity < map->capacity)
+    {
+        resizeTo(map, capacity);
+    }
+}
+
+/**
+ * Shrinks a table that a remove left below its minimum load. The new table
+ * leaves room to grow by the growth factor before it reaches the maximum load
+ * again, so a map whose size swings back and forth doesn't resize every time.
+ * @param map
+ */
+static void shrinkAfterRemove(HashMap *map)
+{
+    if (map->size < map->capacity * map->minLoad)
+    {
+        int capacity = fitCapacity(map, map->size, map->maxLoad / map->growthFactor);
+        if (capacity < map->capacity)
+        {
+            resizeTo(map, capacity);
+        }
+    }
+}
+
+/**
+ * Sets the loads the table is kept between. Puts grow the table by the growth
+ * factor once its load would pass maxLoad, and removes shrink it once its load
+ * drops below minLoad; a minLoad of 0, the default, never shrinks. For a group
+ * probing table deleted slots count against maxLoad too.
+ * @param map
+ * @param maxLoad Largest load, below 1 for open addressing engines.
+ * @param minLoad Smallest load, below maxLoad divided by the growth factor so
+ * that a table that just grew is not shrunk straight back.
+ */
+void hashMapSetLoadFactors(HashMap *map, float maxLoad, float minLoad)
+{
+    assert(map != 0);
+    assert(map->engine != HASH_MAP_SNAPSHOT);
+    assert(maxLoad > 0);
+    assert(map->engine == HASH_MAP_CHAINED || maxLoad < 1);
+    assert(minLoad >= 0 && minLoad * map->growthFactor < maxLoad);
+
+    map->maxLoad = maxLoad;
+    map->minLoad = minLoad;
+    if (map->engine == HASH_MAP_LINEAR_PROBING)
+    {
+        map->probe.maxLoad = maxLoad;
+    }
+    int capacity = fitCapacity(map, map->size, maxLoad);
+    if (map->engine == HASH_MAP_GROUP_PROBING)
+    {
+        // Rebuilding recomputes the room left under the new limit.
+        slotsResize(map, capacity > map->capacity ? capacity : map->capacity);
+    }
+    else if (capacity > map->capacity)
+    {
+        resizeTo(map, capacity);
+    }
+}
+
+/**
+ * Sets the factor a full table grows by. Capacities stay powers of two, so
+ * the factor must be one too; 2 is the default, and larger factors trade
+ * memory for fewer resizes.
+ * @param map
+ * @param growthFactor Power of two, at least 2.
+ */
+void hashMapSetGrowthFactor(HashMap *map, int growthFactor)
+{
+    assert(map != 0);
+    assert(growthFactor >= 2 && (growthFactor & (growthFactor - 1)) == 0);
+    assert(map->minLoad * growthFactor < map->maxLoad);
+    map->growthFactor = growthFactor;
+}
+
+/**
+ * Starts loading the memory a lookup of the given hash will touch first: the
+ * bucket head, or the home slot and its control tags.
+ * @param map
+ * @param hash
+ */
+static void prefetchHash(HashMap *map, uint64_t hash)
+{
+    if (map->engine == HASH_MAP_CHAINED)
+    {
+        PREFETCH(chainedBucket(map, hash));
+    }
+    else if (map->engine == HASH_MAP_SNAPSHOT)
+    {
+        PREFETCH(snapshotHomeSlot(map, hash));
+    }
+    else if (map->engine == HASH_MAP_GROUP_PROBING)
+    {
+        int group = groupHome(map, hash);
+        PREFETCH(map->control + group * GROUP_WIDTH);
+        PREFETCH(map->slots + group * GROUP_WIDTH);
+    }
+    else
+    {
+        PREFETCH(map->slots + probeTableHome(&map->probe, hash));
+    }
+}
+
+/**
+ * Puts hashed keys in a table that has room for them, prefetching the bucket
+ * of the key a few places ahead of each insert.
+ */
+static void putHashed(HashMap *map, const char **keys, const size_t *lengths,
+                      const uint64_t *hashes, int count, int value)
+{
+    for (int i = 0; i < count && i < PREFETCH_DISTANCE; i++)
+    {
+        prefetchHash(map, hashes[i]);
+    }
+    for (int i = 0; i < count; i++)
     {
-        map->table[i] = NULL;
+        int inserted;
+        if (i + PREFETCH_DISTANCE < count)
+        {
+            prefetchHash(map, hashes[i + PREFETCH_DISTANCE]);
+        }
+        *getOrInsertHashed(map, keys[i], lengths[i], hashes[i], value, &inserted) = value;
     }
 }
 
 /**
- * Removes all links in the map and frees all allocated memory. You can use
- * hashLinkDelete to free the links.
+ * Puts every key of an array in the table with the same value, as if by
+ * hashMapPut. The table is grown once up front for the whole batch, and keys
+ * are hashed a block at a time so that each insert can prefetch the bucket of
+ * an insert a few keys ahead.
  * @param map
+ * @param keys
+ * @param count Number of keys.
+ * @param value Value for every key.
  */
-void hashMapCleanUp(HashMap *map)
+void hashMapPutBatch(HashMap *map, const char **keys, int count, int value)
 {
-    HashLink *current;
-    HashLink *nextLink;
+    assert(map != 0);
+    assert(map->engine != HASH_MAP_SNAPSHOT);
+    assert(count == 0 || keys != 0);
 
-    // Free all links.
-    for (int i = 0, cap = map->capacity; i < cap; i++)
+    uint64_t hashes[BATCH_BLOCK];
+    size_t lengths[BATCH_BLOCK];
+
+    hashMapReserve(map, map->size + count);
+    for (int start = 0; start < count; start += BATCH_BLOCK)
     {
-        current = map->table[i];
-        while (current != NULL)
+        int blockSize = count - start < BATCH_BLOCK ? count - start : BATCH_BLOCK;
+        const char **block = keys + start;
+
+        for (int i = 0; i < blockSize; i++)
         {
-            nextLink = current->next;
-            hashLinkDelete(current);
-            current = nextLink;
+            lengths[i] = strlen(block[i]);
+            hashes[i] = hashKey(map, block[i], lengths[i]);
         }
+        putHashed(map, block, lengths, hashes, blockSize, value);
     }
-    free(map->table);
-}
-
-/**
- * Creates a hash table map, allocating memory for a link pointer table with
- * the given number of buckets.
- * @param capacity The number of buckets.
- * @return The allocated map.
- */
-HashMap *hashMapNew(int capacity)
-{
-    HashMap *map = malloc(sizeof(HashMap));
-    hashMapInit(map, capacity);
-    return map;
 }
 
 /**
- * Removes all links in the map and frees all allocated memory, including the
- * map itself.
+ * Like hashMapPutBatch, with the keys' lengths and their hashes from
+ * hashMapHash already computed.
  * @param map
+ * @param keys
+ * @param lengths Bytes in each key.
+ * @param hashes Hash of each key.
+ * @param count Number of keys.
+ * @param value Value for every key.
  */
-void hashMapDelete(HashMap *map)
+void hashMapPutBatchHashed(HashMap *map, const char **keys, const size_t *lengths,
+                           const uint64_t *hashes, int count, int value)
 {
-    hashMapCleanUp(map);
-    free(map);
+    assert(map != 0);
+    assert(map->engine != HASH_MAP_SNAPSHOT);
+    assert(count == 0 || (keys != 0 && lengths != 0 && hashes != 0));
+
+    hashMapReserve(map, map->size + count);
+    putHashed(map, keys, lengths, hashes, count, value);
 }
 
 /**
- * Returns a pointer to the value of the link with the given key  and skip traversing as well. Returns NULL
- * if no link with that key is in the table.
- * 
- * Use HASH_FUNCTION(key) and the map's capacity to find the index of the
- * correct linked list bucket. Also make sure to search the entire list.
- * 
+ * Starts loading what a lookup of the given hash reads after the memory
+ * prefetchHash asked for: the first link of a chained bucket, or the key of
+ * the first slot whose hash (or tag) matches. Only worth calling once that
+ * memory has had time to arrive.
  * @param map
- * @param key
- * @return Link value or NULL if no matching link.
+ * @param hash
  */
-int *hashMapGet(HashMap *map, const char *key)
+static void prefetchCandidate(HashMap *map, uint64_t hash)
 {
-    assert(map != 0);
-    assert(key != 0);
-
-    int hashIndex = HASH_FUNCTION(key) % hashMapCapacity(map);
-    struct HashLink *current = map->table[hashIndex];
-
-    while (current != NULL)
+    if (map->engine == HASH_MAP_CHAINED)
+    {
+        PREFETCH(*chainedBucket(map, hash));
+    }
+    else if (map->engine == HASH_MAP_SNAPSHOT)
+    {
+        PREFETCH(snapshotHomeKey(map, hash));
+    }
+    else if (map->engine == HASH_MAP_GROUP_PROBING)
     {
-        if (strcmp(current->key, key) == 0)
+        int group = groupHome(map, hash);
+        unsigned int matches = groupMatch(map->control + group * GROUP_WIDTH, groupTag(hash));
+        if (matches != 0)
         {
-            return &current->value;
+            PREFETCH(map->slots[group * GROUP_WIDTH + lowestBit(matches)].key);
         }
-        else
+    }
+    else
+    {
+        HashSlot *slot = &map->slots[probeTableHome(&map->probe, hash)];
+        if (slot->probe.hash == hash)
         {
-            current = current->next;
+            PREFETCH(slot->key);
         }
     }
-    return NULL;
 }
 
 /**
- * Resizes the hash table to have a number of buckets equal to the given 
- * capacity (double of the old capacity). After allocating the new table, 
- * all of the links need to rehashed into it because the capacity has changed.
- * 
- * Remember to free the old table and any old links if you use hashMapPut to
- * rehash them.
- * 
- * @param map
- * @param capacity The new number of buckets.
+ * Starts loading the key of the first link of a chained bucket whose hash
+ * matches, once prefetchCandidate has brought in the links.
+ * @param map A HASH_MAP_CHAINED map.
+ * @param hash
  */
-void resizeTable(HashMap *map, int capacity)
+static void prefetchChainedKey(HashMap *map, uint64_t hash)
 {
-    HashMap *newMap = hashMapNew(capacity);
-    HashLink *current;
-
-    // Hash each link in oldMap and put in newMap
-    for (int i = 0, cap = map->capacity; i < cap; i++)
+    for (HashLink *link = *chainedBucket(map, hash); link != NULL; link = link->next)
     {
-        current = map->table[i];
-        while (current != NULL)
+        if (link->hash == hash)
         {
-            hashMapPut(newMap, current->key, current->value);
-            current = current->next;
+            PREFETCH(link->key);
+            return;
         }
     }
-
-    hashMapCleanUp(map);        // Should free the old table
-    map->table = newMap->table; // Set table to newTable
-    map->capacity = newMap->capacity;
-    map->size = newMap->size;
-    free(newMap); // Delete the newly allocated table
 }
 
 /**
- * Updates the given key-value pair in the hash table. If a link with the given
- * key already exists, this will just update the value and skip traversing. Otherwise, it will
- * create a new link with the given key and value and add it to the table
- * bucket's linked list. You can use hashLinkNew to create the link.
- * 
- * Use HASH_FUNCTION(key) and the map's capacity to find the index of the
- * correct linked list bucket.
- * 
+ * Looks up every key of an array, as if by hashMapGet. A block of keys is
+ * hashed first, then each pass over the block only prefetches the next level
+ * of memory its lookups will touch: buckets or home slots, then links or
+ * candidate keys. By the time the last pass compares keys, their cache misses
+ * have overlapped instead of being waited for one after another.
  * @param map
- * @param key
- * @param value
+ * @param keys
+ * @param count Number of keys.
+ * @param values Set to a pointer to each key's value, or NULL if the key is
+ * not in the map.
+ * @return Number of keys found.
  */
-void hashMapPut(HashMap *map, const char *key, int value)
+int hashMapGetBatch(HashMap *map, const char **keys, int count, int **values)
 {
     assert(map != 0);
-    assert(key != 0);
+    assert(count == 0 || (keys != 0 && values != 0));
 
-    int hashIndex = HASH_FUNCTION(key) % hashMapCapacity(map);
-    struct HashLink *current = map->table[hashIndex];
+    uint64_t hashes[BATCH_BLOCK];
+    size_t lengths[BATCH_BLOCK];
+    int found = 0;
 
-    if (hashMapContainsKey(map, key))
+    for (int start = 0; start < count; start += BATCH_BLOCK)
     {
-        // Find the key, replace the value at that link.
-        while (strcmp(current->key, key) != 0)
+        int blockSize = count - start < BATCH_BLOCK ? count - start : BATCH_BLOCK;
+        const char **block = keys + start;
+
+        for (int i = 0; i < blockSize; i++)
         {
-            current = current->next;
+            lengths[i] = strlen(block[i]);
+            hashes[i] = hashKey(map, block[i], lengths[i]);
+            prefetchHash(map, hashes[i]);
         }
-        current->value = value;
-    }
-    else
-    {
-        // Key does not exist, so allocate a new link.
-        HashLink *newLink = hashLinkNew(key, value, NULL);
-
-        // This is the first link being added to the list so set head to newLink
-        if (current == NULL)
+        for (int i = 0; i < blockSize; i++)
         {
-            map->table[hashIndex] = newLink;
+            prefetchCandidate(map, hashes[i]);
         }
-        // List already exists so traverse to the end.
-        else
+        if (map->engine == HASH_MAP_CHAINED)
         {
-            while (current->next != NULL)
+            for (int i = 0; i < blockSize; i++)
             {
-                current = current->next;
+                prefetchChainedKey(map, hashes[i]);
             }
-            current->next = newLink;
         }
-        map->size++;
-        if (hashMapTableLoad(map) > MAX_TABLE_LOAD)
+        for (int i = 0; i < blockSize; i++)
         {
-            resizeTable(map, map->capacity * 2);
+            values[start + i] = getHashed(map, block[i], lengths[i], hashes[i]);
+            found += values[start + i] != NULL;
         }
     }
+    return found;
 }
 
 /**
@@ -256,67 +1635,148 @@ void hashMapPut(HashMap *map, const char *key, int value)
  * @param key
  */
 void hashMapRemove(HashMap *map, const char *key)
+{
+    assert(key != 0);
+    hashMapRemoveN(map, key, strlen(key));
+}
+
+/**
+ * Removes the given key of explicit length from the table. If the key is not
+ * in the table, this does nothing.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ */
+void hashMapRemoveN(HashMap *map, const void *key, size_t length)
+{
+    assert(map != 0);
+    assert(key != 0);
+    hashMapRemoveHashed(map, key, length, hashKey(map, key, length));
+}
+
+/**
+ * Like hashMapRemoveN, with the key's hash already computed by hashMapHash.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @param hash Hash of the key from hashMapHash.
+ */
+void hashMapRemoveHashed(HashMap *map, const void *key, size_t length, uint64_t hash)
 {
     assert(map != 0);
     assert(key != 0);
+    assert(map->engine != HASH_MAP_SNAPSHOT);
+
+    hash = probeHash(hash);
+    STATS_ADD(map, removes, 1);
+    if (map->engine != HASH_MAP_CHAINED)
+    {
+        int index = slotFind(map, key, length, hash, NULL);
+        if (index >= 0)
+        {
+            slotErase(map, index);
+            map->size--;
+            shrinkAfterRemove(map);
+        }
+        return;
+    }
+
+    if (map->oldTable != NULL)
+    {
+        chainedMigrate(map, map->resizeStep);
+    }
 
-    int hashIndex = HASH_FUNCTION(key) % hashMapCapacity(map);
-    struct HashLink *current = map->table[hashIndex];
+    HashLink **bucket = chainedBucket(map, hash);
+    struct HashLink *current = *bucket;
     struct HashLink *prev = NULL;
+    int probes = 0;
+    int compares = 0;
 
     while (current != NULL)
     {
-        if (strcmp(current->key, key) == 0)
+        probes++;
+        int matches = current->hash == hash && current->keyLength == (int)length;
+        compares += matches;
+        if (matches && memcmp(current->key, key, length) == 0)
         {
+            statsSearch(map, probes, compares);
             if (prev == NULL)
             {
-                map->table[hashIndex] = current->next;
+                *bucket = current->next;
             }
             else
             {
                 prev->next = current->next;
             }
             // Delete link and dec count, end function.
-            hashLinkDelete(current);
+            hashLinkDelete(map, current);
             map->size--;
+            shrinkAfterRemove(map);
             return;
         }
         prev = current;
         current = current->next;
     }
+    statsSearch(map, probes, compares);
 }
 
 /**
  * Returns 1 if a link with the given key is in the table and 0 otherwise.
  * 
- * Use HASH_FUNCTION(key) and the map's capacity to find the index of the
+ * Use the map's hash function and capacity to find the index of the
  * correct linked list bucket. Also make sure to search the entire list.
  * 
  * @param map
  * @param key
  * @return 1 if the key is found, 0 otherwise.
  */
-int hashMapContainsKey(HashMap *map, const char *key)
+int hashMapContainsKey(const HashMap *map, const char *key)
 {
-    assert(map != 0);
     assert(key != 0);
+    return hashMapContainsKeyN(map, key, strlen(key));
+}
 
-    int hashIndex = HASH_FUNCTION(key) % hashMapCapacity(map);
+/**
+ * Returns 1 if the given key of explicit length is in the table and 0
+ * otherwise.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int hashMapContainsKeyN(const HashMap *map, const void *key, size_t length)
+{
+    assert(map != 0);
+    assert(key != 0);
+    return hashMapContainsKeyHashed(map, key, length, hashKey(map, key, length));
+}
 
-    struct HashLink *current = map->table[hashIndex];
+/**
+ * Like hashMapContainsKeyN, with the key's hash already computed by
+ * hashMapHash.
+ * @param map
+ * @param key
+ * @param length Bytes in the key.
+ * @param hash Hash of the key from hashMapHash.
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int hashMapContainsKeyHashed(const HashMap *map, const void *key, size_t length,
+                             uint64_t hash)
+{
+    assert(map != 0);
+    assert(key != 0);
 
-    while (current != NULL)
+    hash = probeHash(hash);
+    STATS_ADD(map, lookups, 1);
+    if (map->engine == HASH_MAP_SNAPSHOT)
     {
-        if (strcmp((current->key), key) == 0)
-        {
-            return 1;
-        }
-        else
-        {
-            current = current->next;
-        }
+        return snapshotSearch(map, key, length, hash) >= 0;
     }
-    return 0;
+    if (map->engine != HASH_MAP_CHAINED)
+    {
+        return slotFind(map, key, length, hash, NULL) >= 0;
+    }
+    return chainedFind(map, key, length, hash) != NULL;
 }
 
 /**
@@ -324,7 +1784,7 @@ int hashMapContainsKey(HashMap *map, const char *key)
  * @param map
  * @return Number of links in the table.
  */
-int hashMapSize(HashMap *map)
+int hashMapSize(const HashMap *map)
 {
     assert(map != 0);
     return map->size;
@@ -335,24 +1795,33 @@ int hashMapSize(HashMap *map)
  * @param map
  * @return Number of buckets in the table.
  */
-int hashMapCapacity(HashMap *map)
+int hashMapCapacity(const HashMap *map)
 {
     assert(map != 0);
     return map->capacity;
 }
 
 /**
- * Returns the number of table buckets without any links.
+ * Returns the number of table buckets without any links. During an
+ * incremental resize only the new table is counted.
  * @param map
  * @return Number of empty buckets.
  */
-int hashMapEmptyBuckets(HashMap *map)
+int hashMapEmptyBuckets(const HashMap *map)
 {
     int emptyBucketCounter = 0;
 
     for (int i = 0, cap = hashMapCapacity(map); i < cap; i++)
     {
-        if (map->table[i] == NULL)
+        if (map->engine == HASH_MAP_SNAPSHOT)
+        {
+            emptyBucketCounter += snapshotKey(map, i) == NULL;
+        }
+        else if (map->engine != HASH_MAP_CHAINED)
+        {
+            emptyBucketCounter += map->slots[i].probe.hash == 0;
+        }
+        else if (map->table[i] == NULL)
         {
             emptyBucketCounter++;
         }
@@ -368,11 +1837,193 @@ int hashMapEmptyBuckets(HashMap *map)
  * @param map
  * @return Table load.
  */
-float hashMapTableLoad(HashMap *map)
+float hashMapTableLoad(const HashMap *map)
 {
     return (map->size / (float)map->capacity);
 }
 
+/**
+ * Starts or stops keeping stats. Enabling them clears the counters, and maps
+ * without stats only pay for one test per operation. Counters are updated
+ * atomically, so threads may share a map with stats for lookups, but they
+ * then contend for the counters' cache line; a map shared that way should
+ * only keep stats while it is being measured. The map must not be in use by
+ * other threads during this call or hashMapResetStats.
+ * @param map
+ * @param enabled Nonzero to keep stats.
+ */
+void hashMapSetStats(HashMap *map, int enabled)
+{
+    assert(map != 0);
+    free(map->stats);
+    map->stats = enabled ? calloc(1, sizeof(HashMapStats)) : NULL;
+}
+
+/**
+ * Returns the counters of the map, or NULL if stats are disabled.
+ * @param map
+ * @return Stats of the map.
+ */
+const HashMapStats *hashMapStats(const HashMap *map)
+{
+    assert(map != 0);
+    return map->stats;
+}
+
+/**
+ * Clears the counters of a map that keeps stats.
+ * @param map
+ */
+void hashMapResetStats(HashMap *map)
+{
+    assert(map != 0);
+    if (map->stats != NULL)
+    {
+        memset(map->stats, 0, sizeof(HashMapStats));
+    }
+}
+
+/**
+ * Returns the number of groups a search for the key in the slot at the given
+ * index visits.
+ */
+static int groupProbeLength(const HashMap *map, int index)
+{
+    int groupMask = map->capacity / GROUP_WIDTH - 1;
+    int group = groupHome(map, map->slots[index].probe.hash);
+    int step = 1;
+
+    while (group != index / GROUP_WIDTH)
+    {
+        group = (group + step) & groupMask;
+        step++;
+    }
+    return step;
+}
+
+/**
+ * Counts chain lengths into a histogram, which is unaffected by stats being
+ * enabled. For a chained map entry i counts the buckets holding i links, empty
+ * ones included. Open addressing has no chains, so there entry i counts the
+ * keys a search visits i slots to find, or i groups for group probing.
+ * Longer lengths are counted in the last entry.
+ * @param map
+ * @param histogram Array of length entries to fill, or NULL.
+ * @param length Number of histogram entries.
+ * @param mean Set to the mean length of nonempty chains, or of searches for
+ * the keys of an open addressing map, or NULL.
+ * @return Longest chain or search.
+ */
+int hashMapChainLengths(const HashMap *map, int *histogram, int length, double *mean)
+{
+    assert(map != 0);
+    assert(histogram == NULL || length > 0);
+
+    int longest = 0;
+    long long total = 0;
+    int counted = 0;
+    int chained = map->engine == HASH_MAP_CHAINED;
+    int buckets = chained ? chainedBucketCount(map) : map->capacity;
+
+    if (histogram != NULL)
+    {
+        memset(histogram, 0, sizeof(int) * length);
+    }
+    for (int i = 0; i < buckets; i++)
+    {
+        int chain = 0;
+        if (chained)
+        {
+            for (HashLink *link = chainedBucketAt(map, i); link != NULL; link = link->next)
+            {
+                chain++;
+            }
+        }
+        else if (map->engine == HASH_MAP_SNAPSHOT)
+        {
+            chain = snapshotProbeLength(map, i);
+        }
+        else if (map->slots[i].probe.hash == 0)
+        {
+            chain = 0;
+        }
+        else if (map->engine == HASH_MAP_GROUP_PROBING)
+        {
+            chain = groupProbeLength(map, i);
+        }
+        else
+        {
+            int home = probeTableHome(&map->probe, map->slots[i].probe.hash);
+            chain = ((i - home) & (map->capacity - 1)) + 1;
+        }
+        if (!chained && chain == 0)
+        {
+            continue;
+        }
+        if (histogram != NULL)
+        {
+            histogram[chain < length ? chain : length - 1]++;
+        }
+        longest = chain > longest ? chain : longest;
+        total += chain;
+        counted += chain > 0;
+    }
+    if (mean != NULL)
+    {
+        *mean = counted > 0 ? (double)total / counted : 0;
+    }
+    return longest;
+}
+
+/**
+ * Writes the shape of the table, its chain lengths and, if stats are enabled,
+ * its counters as one JSON object.
+ * @param map
+ * @param file
+ */
+void hashMapPrintStatsJson(const HashMap *map, FILE *file)
+{
+    assert(map != 0);
+    assert(file != 0);
+
+    static const char *engines[] = {"chained", "linearProbing", "groupProbing", "snapshot"};
+    int histogram[STATS_HISTOGRAM_LENGTH];
+    double mean;
+    int longest = hashMapChainLengths(map, histogram, STATS_HISTOGRAM_LENGTH, &mean);
+    int used = STATS_HISTOGRAM_LENGTH;
+
+    while (used > 1 && histogram[used - 1] == 0)
+    {
+        used--;
+    }
+    fprintf(file, "{\"engine\": \"%s\", \"size\": %d, \"capacity\": %d, \"load\": %g, "
+                  "\"emptyBuckets\": %d, ",
+            engines[map->engine], map->size, map->capacity, hashMapTableLoad(map),
+            hashMapEmptyBuckets(map));
+    fprintf(file, "\"chainLength\": {\"max\": %d, \"mean\": %g, \"histogram\": [", longest,
+            mean);
+    for (int i = 0; i < used; i++)
+    {
+        fprintf(file, i > 0 ? ", %d" : "%d", histogram[i]);
+    }
+    fprintf(file, "]}, \"stats\": ");
+
+    const HashMapStats *stats = map->stats;
+    if (stats == NULL)
+    {
+        fprintf(file, "null}\n");
+        return;
+    }
+    long long searches = stats->lookups + stats->puts + stats->removes;
+    fprintf(file,
+            "{\"lookups\": %lld, \"puts\": %lld, \"inserts\": %lld, \"removes\": %lld, "
+            "\"probes\": %lld, \"compares\": %lld, \"probesPerSearch\": %g, "
+            "\"maxProbes\": %d, \"resizes\": %d, \"resizeSeconds\": %g}}\n",
+            stats->lookups, stats->puts, stats->inserts, stats->removes, stats->probes,
+            stats->compares, searches > 0 ? (double)stats->probes / searches : 0,
+            stats->maxProbes, stats->resizes, stats->resizeSeconds);
+}
+
 /**
  * Prints all the links in each of the buckets in the table.
  * @param map
@@ -382,10 +2033,25 @@ void hashMapPrint(HashMap *map)
     assert(map != 0);
     HashLink *current;
 
-    for (int i = 0, cap = hashMapCapacity(map); i < cap; i++)
+    if (map->engine != HASH_MAP_CHAINED)
+    {
+        HashMapIterator iterator;
+        const char *key;
+        int *value;
+
+        hashMapIteratorInit(&iterator, map);
+        while (hashMapIteratorNext(&iterator, &key, &value))
+        {
+            printf("%d: [%s, %d]\n", iterator.index, key, *value);
+        }
+        return;
+    }
+
+    for (int i = 0, cap = chainedBucketCount(map); i < cap; i++)
     {
-        current = map->table[i];
+        current = chainedBucketAt(map, i);
 
+        // Buckets past capacity belong to the old table of a resize.
         printf("%d: ", i);
         while (current != NULL)
         {
@@ -395,3 +2061,83 @@ void hashMapPrint(HashMap *map)
         printf("\n");
     }
 }
+
+/**
+ * Prepares an iterator over every key-value pair in the map, in table order.
+ * The map must not be modified while the iterator is in use.
+ * @param iterator
+ * @param map
+ */
+void hashMapIteratorInit(HashMapIterator *iterator, HashMap *map)
+{
+    assert(map != 0);
+    iterator->map = map;
+    iterator->index = -1;
+    iterator->link = NULL;
+    iterator->keyLength = 0;
+    iterator->hash = 0;
+}
+
+/**
+ * Advances the iterator to the next key-value pair.
+ * @param iterator
+ * @param key Set to the key of the next pair. Its length is left in
+ * iterator->keyLength, for keys that hold zero bytes, and its hash in
+ * iterator->hash.
+ * @param value Set to a pointer to the value of the next pair.
+ * @return 1 if a pair was produced, 0 once the map is exhausted.
+ */
+int hashMapIteratorNext(HashMapIterator *iterator, const char **key, int **value)
+{
+    HashMap *map = iterator->map;
+
+    if (map->engine == HASH_MAP_SNAPSHOT)
+    {
+        while (iterator->index + 1 < map->capacity)
+        {
+            *key = snapshotKey(map, ++iterator->index);
+            if (*key != NULL)
+            {
+                iterator->keyLength = snapshotKeyLength(map, iterator->index);
+                iterator->hash = snapshotKeyHash(map, iterator->index);
+                *value = snapshotValue(map, iterator->index);
+                return 1;
+            }
+        }
+        return 0;
+    }
+    if (map->engine != HASH_MAP_CHAINED)
+    {
+        while (iterator->index + 1 < map->capacity)
+        {
+            HashSlot *slot = &map->slots[++iterator->index];
+            if (slot->probe.hash != 0)
+            {
+                *key = slot->key;
+                iterator->keyLength = slot->keyLength;
+                iterator->hash = slot->probe.hash;
+                *value = &slot->value;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    if (iterator->link != NULL)
+    {
+        iterator->link = iterator->link->next;
+    }
+    while (iterator->link == NULL)
+    {
+        if (iterator->index + 1 >= chainedBucketCount(map))
+        {
+            return 0;
+        }
+        iterator->link = chainedBucketAt(map, ++iterator->index);
+    }
+    *key = iterator->link->key;
+    iterator->keyLength = iterator->link->keyLength;
+    iterator->hash = iterator->link->hash;
+    *value = &iterator->link->value;
+    return 1;
+}
@@ -6,39 +6,190 @@
  * Assignment 5
  */
 
-#define HASH_FUNCTION hashFunction1
+#include "hashFunctions.h"
+#include "memoryPool.h"
+#include "probeTable.h"
+#include <stdio.h>
+
+// Default hash function and seed of new maps; see hashMapSetHashFunction.
+#define HASH_FUNCTION hashFunctionWy
+#define HASH_SEED 0
+// Default load limits and growth of new maps; see hashMapSetLoadFactors.
 #define MAX_TABLE_LOAD 1
+// Open addressing needs free slots to terminate probes, so it grows earlier.
+#define MAX_PROBE_TABLE_LOAD 0.75
+// Group probing counts deleted slots against this limit too.
+#define MAX_GROUP_TABLE_LOAD 0.875
+// Tables never shrink by default.
+#define MIN_TABLE_LOAD 0
+#define GROWTH_FACTOR 2
 
 typedef struct HashMap HashMap;
 typedef struct HashLink HashLink;
+typedef struct HashSlot HashSlot;
+typedef struct HashMapIterator HashMapIterator;
+typedef struct HashMapStats HashMapStats;
+
+typedef enum HashMapEngine
+{
+    // Array of buckets, each a linked list of separately allocated links.
+    HASH_MAP_CHAINED,
+    // One contiguous array of slots holding hash, key and value inline.
+    HASH_MAP_LINEAR_PROBING,
+    // Slots plus a separate array of one byte hash tags, probed in groups of
+    // 16 with SSE2 (or a scalar loop).
+    HASH_MAP_GROUP_PROBING,
+    // Read-only table mapped from a file; see hashMapLoadSnapshot.
+    HASH_MAP_SNAPSHOT
+} HashMapEngine;
 
 struct HashLink
 {
     char* key;
     int value;
+    // Bytes in the key, not counting the zero stored after them.
+    int keyLength;
     HashLink* next;
+    // Full hash of the key, compared before the key itself.
+    uint64_t hash;
+};
+
+struct HashSlot
+{
+    // Hash of the key, never 0, or 0 when the slot is empty.
+    ProbeSlot probe;
+    char* key;
+    int value;
+    int keyLength;
+};
+
+// Counters kept by a map while stats are enabled; see hashMapSetStats.
+struct HashMapStats
+{
+    // Calls of hashMapGet and hashMapContainsKey, including batched ones.
+    long long lookups;
+    // Calls that may insert a key, and the keys they inserted.
+    long long puts;
+    long long inserts;
+    long long removes;
+    // Links, slots or groups visited by the searches of those calls, and keys
+    // compared in full after their hashes matched.
+    long long probes;
+    long long compares;
+    // Longest single search.
+    int maxProbes;
+    // Resizes that changed the capacity, and processor time spent moving
+    // keys, rehashes at the same capacity included.
+    int resizes;
+    double resizeSeconds;
 };
 
 struct HashMap
 {
+    HashMapEngine engine;
+    HashFunction hashFunction;
+    uint64_t seed;
+    // Buckets of a HASH_MAP_CHAINED map.
     HashLink** table;
+    // Buckets not yet migrated by an incremental resize, or NULL.
+    HashLink** oldTable;
+    int oldCapacity;
+    // Old buckets below this index have been migrated.
+    int migrateIndex;
+    // Old buckets migrated per operation, or 0 to resize all at once.
+    int resizeStep;
+    // Slots of an open addressing map.
+    HashSlot* slots;
+    // Linear probing table whose slots are the slots of a
+    // HASH_MAP_LINEAR_PROBING map, or a view of the mapped slots of a
+    // HASH_MAP_SNAPSHOT map.
+    ProbeTable probe;
+    // Control tags of a HASH_MAP_GROUP_PROBING map, one per slot.
+    unsigned char* control;
+    // Empty slots a HASH_MAP_GROUP_PROBING map may still fill before resizing.
+    int growthLeft;
+    // Mapped file of a HASH_MAP_SNAPSHOT map.
+    void* snapshot;
+    size_t snapshotLength;
+    // Links of a chained map are allocated from this pool.
+    Pool linkPool;
+    // Copies of the keys of every engine.
+    Arena keyArena;
+    // Nonzero if the map stores callers' key pointers instead of copies.
+    int borrowKeys;
     // Number of links in the table.
     int size;
-    // Number of buckets in the table.
+    // Number of buckets in the table, a power of two.
     int capacity;
+    // Loads the table grows above and shrinks below.
+    float maxLoad;
+    float minLoad;
+    // Factor the table grows by, a power of two.
+    int growthFactor;
+    // Counters of the map, or NULL if stats are disabled.
+    HashMapStats* stats;
+};
+
+struct HashMapIterator
+{
+    HashMap* map;
+    int index;
+    HashLink* link;
+    // Length of the key last produced.
+    int keyLength;
+    // Hash of the key last produced, as cached by the map.
+    uint64_t hash;
 };
 
 HashMap* hashMapNew(int capacity);
+HashMap* hashMapNewEngine(int capacity, HashMapEngine engine);
 void hashMapDelete(HashMap* map);
 int* hashMapGet(HashMap* map, const char* key);
 void hashMapPut(HashMap* map, const char* key, int value);
+int* hashMapGetOrInsert(HashMap* map, const char* key, int value, int* inserted);
+void hashMapPutBatch(HashMap* map, const char** keys, int count, int value);
+int hashMapGetBatch(HashMap* map, const char** keys, int count, int** values);
 void hashMapRemove(HashMap* map, const char* key);
-int hashMapContainsKey(HashMap* map, const char* key);
+int hashMapContainsKey(const HashMap* map, const char* key);
+int* hashMapGetN(HashMap* map, const void* key, size_t length);
+void hashMapPutN(HashMap* map, const void* key, size_t length, int value);
+int* hashMapGetOrInsertN(HashMap* map, const void* key, size_t length, int value, int* inserted);
+void hashMapRemoveN(HashMap* map, const void* key, size_t length);
+int hashMapContainsKeyN(const HashMap* map, const void* key, size_t length);
+uint64_t hashMapHash(const HashMap* map, const void* key, size_t length);
+int* hashMapGetHashed(HashMap* map, const void* key, size_t length, uint64_t hash);
+int* hashMapGetOrInsertHashed(HashMap* map, const void* key, size_t length, uint64_t hash,
+                              int value, int* inserted);
+void hashMapPutBatchHashed(HashMap* map, const char** keys, const size_t* lengths,
+                           const uint64_t* hashes, int count, int value);
+void hashMapRemoveHashed(HashMap* map, const void* key, size_t length, uint64_t hash);
+int hashMapContainsKeyHashed(const HashMap* map, const void* key, size_t length,
+                             uint64_t hash);
+void hashMapSetHashFunction(HashMap* map, HashFunction hashFunction, uint64_t seed);
+void hashMapSetIncrementalResize(HashMap* map, int bucketsPerStep);
+void hashMapSetBorrowedKeys(HashMap* map, int borrowed);
+void hashMapFinishResize(HashMap* map);
+void hashMapSetLoadFactors(HashMap* map, float maxLoad, float minLoad);
+void hashMapSetGrowthFactor(HashMap* map, int growthFactor);
+void hashMapReserve(HashMap* map, int count);
+void hashMapShrinkToFit(HashMap* map);
 
-int hashMapSize(HashMap* map);
-int hashMapCapacity(HashMap* map);
-int hashMapEmptyBuckets(HashMap* map);
-float hashMapTableLoad(HashMap* map);
+int hashMapSize(const HashMap* map);
+int hashMapCapacity(const HashMap* map);
+int hashMapEmptyBuckets(const HashMap* map);
+float hashMapTableLoad(const HashMap* map);
 void hashMapPrint(HashMap* map);
 
-#endif
\ No newline at end of file
+void hashMapSetStats(HashMap* map, int enabled);
+const HashMapStats* hashMapStats(const HashMap* map);
+void hashMapResetStats(HashMap* map);
+int hashMapChainLengths(const HashMap* map, int* histogram, int length, double* mean);
+void hashMapPrintStatsJson(const HashMap* map, FILE* file);
+
+int hashMapSave(HashMap* map, const char* path);
+HashMap* hashMapLoadSnapshot(const char* path);
+
+void hashMapIteratorInit(HashMapIterator* iterator, HashMap* map);
+int hashMapIteratorNext(HashMapIterator* iterator, const char** key, int** value);
+
+#endif
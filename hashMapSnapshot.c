@@ -0,0 +1,439 @@
+/*
+ * CS 261 Data Structures
+ * On-disk snapshots of a hash map.
+ *
+ * A snapshot file is a header, a linear probing slot array and the key bytes.
+ * Slots refer to keys by offset, so the file can be mapped at any address and
+ * queried in place. Numbers are stored in native byte order; the header
+ * records it so a file from a different machine is rejected.
+ *
+ * The file is sized for loading rather than inserting: slots are 16 bytes,
+ * with each key's length stored in front of its bytes, and the table is
+ * filled up to SNAPSHOT_LOAD instead of the load a map grows at.
+ *
+ * The slot array is a ProbeTable: slots are placed by probeTableInsert when
+ * saving and searched by probeTableFind in the mapped file, so the stored
+ * hashes and the slot a search starts at are those of probeTable.c.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "hashMapSnapshot.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SNAPSHOT_MAGIC "HMAPSNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+// Largest load of a saved table. Nothing is inserted after saving, so it can
+// be fuller than a map that grows; misses probe a few more slots.
+#define SNAPSHOT_LOAD 0.875
+
+typedef struct SnapshotHeader SnapshotHeader;
+typedef struct SnapshotSlot SnapshotSlot;
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    // hashFunctionId of the hash function the slots were placed with.
+    uint32_t hashId;
+    uint32_t reserved;
+    uint64_t seed;
+    uint64_t size;
+    // Number of slots, a power of two.
+    uint64_t capacity;
+    uint64_t keysOffset;
+    uint64_t keysLength;
+    // hashFunctionWy of every byte after the header.
+    uint64_t checksum;
+};
+
+struct SnapshotSlot
+{
+    // Hash of the key, never 0, or 0 if the slot is empty.
+    ProbeSlot probe;
+    // Offset of the key in the key bytes. The key is followed by a zero and
+    // preceded by its length, a 32-bit number at a multiple of 4 bytes.
+    uint32_t keyOffset;
+    int32_t value;
+};
+
+#define SNAPSHOT_LENGTH_SIZE sizeof(uint32_t)
+
+static SnapshotHeader *snapshotHeader(const HashMap *map)
+{
+    return map->snapshot;
+}
+
+static SnapshotSlot *snapshotSlots(const HashMap *map)
+{
+    return (SnapshotSlot *)((char *)map->snapshot + sizeof(SnapshotHeader));
+}
+
+static const char *snapshotKeys(const HashMap *map)
+{
+    return (const char *)map->snapshot + snapshotHeader(map)->keysOffset;
+}
+
+/**
+ * Returns the length stored in front of a key in the key bytes.
+ */
+static uint32_t snapshotLength(const char *keys, uint32_t keyOffset)
+{
+    return *(const uint32_t *)(keys + keyOffset - SNAPSHOT_LENGTH_SIZE);
+}
+
+// Key searched for by snapshotFind, with the key bytes of its map.
+typedef struct SnapshotQuery
+{
+    const char *keys;
+    const char *key;
+} SnapshotQuery;
+
+/**
+ * Compares the key of a slot whose hash matched with a SnapshotQuery's key.
+ */
+static int snapshotMatch(const ProbeSlot *slot, const void *key, size_t length)
+{
+    const SnapshotSlot *snapshotSlot = (const SnapshotSlot *)slot;
+    const SnapshotQuery *query = key;
+    return snapshotLength(query->keys, snapshotSlot->keyOffset) == length &&
+           memcmp(query->keys + snapshotSlot->keyOffset, query->key, length) == 0;
+}
+
+/**
+ * Returns the index of the slot holding the given key, or -1.
+ * @param map A HASH_MAP_SNAPSHOT map.
+ * @param key
+ * @param length Bytes in the key.
+ * @param hash The key's hash.
+ * @param probes Set to the number of slots visited.
+ * @param compares Set to the number of keys compared in full.
+ * @return Slot index or -1.
+ */
+int snapshotFind(const HashMap *map, const char *key, size_t length, uint64_t hash,
+                 int *probes, int *compares)
+{
+    SnapshotQuery query = {snapshotKeys(map), key};
+    ProbeSearch search;
+    int index = probeTableFind(&map->probe, probeHash(hash), &query, length, snapshotMatch,
+                               &search);
+    *probes = search.probes;
+    *compares = search.compares;
+    return index;
+}
+
+/**
+ * Returns the key in the slot at the given index, or NULL if it is empty.
+ */
+const char *snapshotKey(const HashMap *map, int index)
+{
+    SnapshotSlot *slot = &snapshotSlots(map)[index];
+    if (slot->probe.hash == 0)
+    {
+        return NULL;
+    }
+    return snapshotKeys(map) + slot->keyOffset;
+}
+
+/**
+ * Returns the length of the key in the occupied slot at the given index.
+ */
+int snapshotKeyLength(const HashMap *map, int index)
+{
+    return (int)snapshotLength(snapshotKeys(map), snapshotSlots(map)[index].keyOffset);
+}
+
+/**
+ * Returns the hash of the key in the occupied slot at the given index.
+ */
+uint64_t snapshotKeyHash(const HashMap *map, int index)
+{
+    return snapshotSlots(map)[index].probe.hash;
+}
+
+/**
+ * Returns the number of slots a search for the key in the slot at the given
+ * index visits, or 0 if the slot is empty.
+ */
+int snapshotProbeLength(const HashMap *map, int index)
+{
+    SnapshotSlot *slot = &snapshotSlots(map)[index];
+    if (slot->probe.hash == 0)
+    {
+        return 0;
+    }
+    int home = probeTableHome(&map->probe, slot->probe.hash);
+    return ((index - home) & (map->capacity - 1)) + 1;
+}
+
+/**
+ * Returns the home slot of a hash, for prefetching.
+ */
+const void *snapshotHomeSlot(const HashMap *map, uint64_t hash)
+{
+    return &snapshotSlots(map)[probeTableHome(&map->probe, probeHash(hash))];
+}
+
+/**
+ * Returns the key in the home slot of a hash if the slot's hash matches, or
+ * NULL, for prefetching.
+ */
+const char *snapshotHomeKey(const HashMap *map, uint64_t hash)
+{
+    hash = probeHash(hash);
+    SnapshotSlot *slot = &snapshotSlots(map)[probeTableHome(&map->probe, hash)];
+    if (slot->probe.hash != hash)
+    {
+        return NULL;
+    }
+    return snapshotKeys(map) + slot->keyOffset;
+}
+
+/**
+ * Returns the value in the slot at the given index. The mapping is private,
+ * so writes change this process's copy only.
+ */
+int *snapshotValue(HashMap *map, int index)
+{
+    return &snapshotSlots(map)[index].value;
+}
+
+/**
+ * Unmaps the snapshot file of a map.
+ */
+void snapshotClose(HashMap *map)
+{
+    munmap(map->snapshot, map->snapshotLength);
+}
+
+/**
+ * Returns the bytes a key of the given length takes in the key bytes: its
+ * length, the key and a zero, rounded up so the next length stays aligned.
+ */
+static size_t snapshotKeySize(size_t length)
+{
+    size_t size = SNAPSHOT_LENGTH_SIZE + length + 1;
+    return (size + SNAPSHOT_LENGTH_SIZE - 1) / SNAPSHOT_LENGTH_SIZE * SNAPSHOT_LENGTH_SIZE;
+}
+
+/**
+ * Writes a snapshot of the map to a file, which hashMapLoadSnapshot can map
+ * back in without rehashing or copying. Keys are placed by the hashes the map
+ * cached for them, so nothing is hashed. The map must use one of the hash
+ * functions of hashFunctions.h.
+ * @param map
+ * @param path
+ * @return 0 on success, -1 if the map can't be saved or the file can't be
+ *         written.
+ */
+int hashMapSave(HashMap *map, const char *path)
+{
+    assert(map != 0);
+    assert(path != 0);
+
+    int hashId = hashFunctionId(map->hashFunction);
+    if (hashId < 0)
+    {
+        return -1;
+    }
+
+    // Lay out the key bytes and slots.
+    SnapshotHeader header;
+    HashMapIterator iterator;
+    const char *key;
+    int *value;
+    size_t keysLength = 0;
+    hashMapIteratorInit(&iterator, map);
+    while (hashMapIteratorNext(&iterator, &key, &value))
+    {
+        keysLength += snapshotKeySize(iterator.keyLength);
+    }
+    if (keysLength > UINT32_MAX)
+    {
+        return -1;
+    }
+
+    // The slots are a table sized up front, so no insert resizes it, with
+    // the key bytes appended to its allocation to checksum and write both
+    // at once.
+    ProbeTable table;
+    probeTableInit(&table, 0, sizeof(SnapshotSlot));
+    table.maxLoad = SNAPSHOT_LOAD;
+    probeTableReserve(&table, map->size);
+    size_t slotsLength = sizeof(SnapshotSlot) * table.capacity;
+    size_t payloadLength = slotsLength + keysLength;
+    char *payload = realloc(table.slots, payloadLength);
+    char *keys = payload + slotsLength;
+    uint32_t keyOffset = 0;
+    table.slots = payload;
+    memset(keys, 0, keysLength);
+
+    hashMapIteratorInit(&iterator, map);
+    while (hashMapIteratorNext(&iterator, &key, &value))
+    {
+        uint64_t hash = probeHash(iterator.hash);
+        SnapshotSlot *slot = (SnapshotSlot *)probeTableInsert(&table, hash, -1);
+        uint32_t length = iterator.keyLength;
+        slot->keyOffset = keyOffset + SNAPSHOT_LENGTH_SIZE;
+        slot->value = *value;
+        // Borrowed keys need not be terminated; the zero comes from the memset.
+        memcpy(keys + keyOffset, &length, SNAPSHOT_LENGTH_SIZE);
+        memcpy(keys + slot->keyOffset, key, length);
+        keyOffset += snapshotKeySize(length);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.hashId = hashId;
+    header.seed = map->seed;
+    header.size = map->size;
+    header.capacity = table.capacity;
+    header.keysOffset = sizeof(SnapshotHeader) + slotsLength;
+    header.keysLength = keysLength;
+    header.checksum = hashFunctionWy(payload, payloadLength, 0);
+
+    FILE *file = fopen(path, "wb");
+    int result = -1;
+    if (file != NULL)
+    {
+        if (fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(payload, 1, payloadLength, file) == payloadLength)
+        {
+            result = 0;
+        }
+        if (fclose(file) != 0)
+        {
+            result = -1;
+        }
+    }
+    probeTableRelease(&table);
+    return result;
+}
+
+/**
+ * Checks that a mapped file is a complete, uncorrupted snapshot this build
+ * can read.
+ */
+static int snapshotValid(const char *data, size_t length)
+{
+    const SnapshotHeader *header = (const SnapshotHeader *)data;
+
+    if (length < sizeof(SnapshotHeader) ||
+        memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SNAPSHOT_VERSION ||
+        header->byteOrder != SNAPSHOT_BYTE_ORDER ||
+        hashFunctionById(header->hashId) == NULL)
+    {
+        return 0;
+    }
+    if (header->capacity < 2 || (header->capacity & (header->capacity - 1)) != 0 ||
+        header->capacity > (uint64_t)1 << 30 || header->size >= header->capacity)
+    {
+        return 0;
+    }
+    uint64_t slotsLength = sizeof(SnapshotSlot) * header->capacity;
+    if (header->keysOffset != sizeof(SnapshotHeader) + slotsLength ||
+        header->keysOffset + header->keysLength != length)
+    {
+        return 0;
+    }
+    if (hashFunctionWy(data + sizeof(SnapshotHeader),
+                       length - sizeof(SnapshotHeader), 0) != header->checksum)
+    {
+        return 0;
+    }
+
+    // Every key must have an aligned length in front of it and be null
+    // terminated inside the key bytes, and the occupied slots must match the
+    // size. Since the size is below the capacity, an empty slot is left to
+    // end every probe.
+    const SnapshotSlot *slots = (const SnapshotSlot *)(data + sizeof(SnapshotHeader));
+    const char *keys = data + header->keysOffset;
+    uint64_t occupied = 0;
+    for (uint64_t i = 0; i < header->capacity; i++)
+    {
+        if (slots[i].probe.hash == 0)
+        {
+            continue;
+        }
+        if (slots[i].keyOffset < SNAPSHOT_LENGTH_SIZE ||
+            slots[i].keyOffset % SNAPSHOT_LENGTH_SIZE != 0 ||
+            slots[i].keyOffset > header->keysLength)
+        {
+            return 0;
+        }
+        uint64_t end = (uint64_t)slots[i].keyOffset + snapshotLength(keys, slots[i].keyOffset);
+        if (end >= header->keysLength || keys[end] != '\0')
+        {
+            return 0;
+        }
+        occupied++;
+    }
+    return occupied == header->size;
+}
+
+/**
+ * Maps a snapshot written by hashMapSave and returns a read-only map over it.
+ * Lookups and iteration work directly on the mapped file; nothing is rehashed
+ * or allocated per key. Values may be written through hashMapGet, but only
+ * this process sees the change. Puts and removes are not allowed.
+ * @param path
+ * @return The map, or NULL if the file is missing, corrupt or from an
+ *         incompatible build.
+ */
+HashMap *hashMapLoadSnapshot(const char *path)
+{
+    assert(path != 0);
+
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(SnapshotHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t length = info.st_size;
+    char *data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return NULL;
+    }
+    if (!snapshotValid(data, length))
+    {
+        munmap(data, length);
+        return NULL;
+    }
+
+    SnapshotHeader *header = (SnapshotHeader *)data;
+    HashMap *map = hashMapNewEngine(0, HASH_MAP_SNAPSHOT);
+    map->snapshot = data;
+    map->snapshotLength = length;
+    map->hashFunction = hashFunctionById(header->hashId);
+    map->seed = header->seed;
+    map->size = header->size;
+    map->capacity = header->capacity;
+    // A view of the mapped slots for probeTableFind; it is never resized or
+    // released.
+    map->probe.slots = data + sizeof(SnapshotHeader);
+    map->probe.slotSize = sizeof(SnapshotSlot);
+    map->probe.size = map->size;
+    map->probe.capacity = map->capacity;
+    map->probe.maxLoad = SNAPSHOT_LOAD;
+    return map;
+}
@@ -0,0 +1,23 @@
+#ifndef HASH_MAP_SNAPSHOT_H
+#define HASH_MAP_SNAPSHOT_H
+
+/*
+ * Read-only HASH_MAP_SNAPSHOT engine: a table saved by hashMapSave and mapped
+ * back in place by hashMapLoadSnapshot. These functions are called by
+ * hashMap.c; use the hashMap functions rather than calling them directly.
+ */
+
+#include "hashMap.h"
+
+int snapshotFind(const HashMap* map, const char* key, size_t length, uint64_t hash,
+                 int* probes, int* compares);
+const char* snapshotKey(const HashMap* map, int index);
+int snapshotKeyLength(const HashMap* map, int index);
+uint64_t snapshotKeyHash(const HashMap* map, int index);
+const void* snapshotHomeSlot(const HashMap* map, uint64_t hash);
+const char* snapshotHomeKey(const HashMap* map, uint64_t hash);
+int* snapshotValue(HashMap* map, int index);
+int snapshotProbeLength(const HashMap* map, int index);
+void snapshotClose(HashMap* map);
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * CS 261 Data Structures
+ * Hash map with 64-bit integer keys.
+ */
+
+#include "intHashMap.h"
+#include <stdlib.h>
+#include <assert.h>
+
+/**
+ * Returns the hash of a key. The key is mixed with the finalizer of
+ * MurmurHash3, so sequential ids and ids differing only in high bits still
+ * spread across the table.
+ */
+static uint64_t intHash(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ull;
+    key ^= key >> 33;
+    return probeHash(key);
+}
+
+/**
+ * Returns the slot at the given index.
+ */
+static IntSlot *slotAt(const IntHashMap *map, int index)
+{
+    return (IntSlot *)map->table.slots + index;
+}
+
+/**
+ * Compares the key of a slot with the key pointed to.
+ */
+static int intMatch(const ProbeSlot *slot, const void *key, size_t length)
+{
+    (void)length;
+    return ((const IntSlot *)slot)->key == *(const uint64_t *)key;
+}
+
+/**
+ * Returns the index of the slot holding the given key, or -1 if the key is not
+ * in the table.
+ * @param search Set to what the search saw, including the free slot that
+ *               ended a failed search. May be NULL.
+ */
+static int intFind(const IntHashMap *map, uint64_t key, uint64_t hash, ProbeSearch *search)
+{
+    return probeTableFind(&map->table, hash, &key, sizeof(key), intMatch, search);
+}
+
+/**
+ * Creates an empty map.
+ * @param capacity Number of keys the map holds before it first grows.
+ * @return The allocated map.
+ */
+IntHashMap *intHashMapNew(int capacity)
+{
+    IntHashMap *map = malloc(sizeof(IntHashMap));
+    probeTableInit(&map->table, capacity, sizeof(IntSlot));
+    return map;
+}
+
+/**
+ * Frees the map and everything in it.
+ * @param map
+ */
+void intHashMapDelete(IntHashMap *map)
+{
+    assert(map != 0);
+    probeTableRelease(&map->table);
+    free(map);
+}
+
+/**
+ * Returns a pointer to the value of the given key, or NULL if the key is not
+ * in the map. The pointer is valid until the map is next modified.
+ * @param map
+ * @param key
+ * @return Value or NULL.
+ */
+int *intHashMapGet(const IntHashMap *map, uint64_t key)
+{
+    assert(map != 0);
+    int index = intFind(map, key, intHash(key), NULL);
+    return index < 0 ? NULL : &slotAt(map, index)->value;
+}
+
+/**
+ * Returns a pointer to the value of the given key, adding the key with the
+ * given value first if it is not in the map.
+ * @param map
+ * @param key
+ * @param value Value of the key if it has to be added.
+ * @param inserted Set to 1 if the key was added, 0 if it existed. May be
+ *                 NULL.
+ * @return Pointer to the key's value, valid until the map is next modified.
+ */
+int *intHashMapGetOrInsert(IntHashMap *map, uint64_t key, int value, int *inserted)
+{
+    assert(map != 0);
+
+    uint64_t hash = intHash(key);
+    ProbeSearch search;
+    int index = intFind(map, key, hash, &search);
+    if (inserted != NULL)
+    {
+        *inserted = index < 0;
+    }
+    if (index >= 0)
+    {
+        return &slotAt(map, index)->value;
+    }
+
+    IntSlot *slot = (IntSlot *)probeTableInsert(&map->table, hash, search.freeIndex);
+    slot->key = key;
+    slot->value = value;
+    return &slot->value;
+}
+
+/**
+ * Sets the value of the given key, adding the key if it is not in the map.
+ * @param map
+ * @param key
+ * @param value
+ */
+void intHashMapPut(IntHashMap *map, uint64_t key, int value)
+{
+    *intHashMapGetOrInsert(map, key, value, NULL) = value;
+}
+
+/**
+ * Removes the given key. The table shrinks once it drops below its minimum
+ * load.
+ * @param map
+ * @param key
+ * @return 1 if the key was removed, 0 if it was not in the map.
+ */
+int intHashMapRemove(IntHashMap *map, uint64_t key)
+{
+    assert(map != 0);
+
+    int index = intFind(map, key, intHash(key), NULL);
+    if (index < 0)
+    {
+        return 0;
+    }
+    probeTableErase(&map->table, index);
+    return 1;
+}
+
+/**
+ * Returns 1 if the given key is in the map and 0 otherwise.
+ * @param map
+ * @param key
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int intHashMapContainsKey(const IntHashMap *map, uint64_t key)
+{
+    assert(map != 0);
+    return intFind(map, key, intHash(key), NULL) >= 0;
+}
+
+/**
+ * Returns the number of keys in the map.
+ * @param map
+ * @return Number of keys.
+ */
+int intHashMapSize(const IntHashMap *map)
+{
+    assert(map != 0);
+    return map->table.size;
+}
+
+/**
+ * Returns the number of slots in the table.
+ * @param map
+ * @return Number of slots.
+ */
+int intHashMapCapacity(const IntHashMap *map)
+{
+    assert(map != 0);
+    return map->table.capacity;
+}
+
+/**
+ * Sets the loads the table is kept between; see hashMapSetLoadFactors.
+ * @param map
+ * @param maxLoad Largest load, below 1.
+ * @param minLoad Smallest load; 0, the default, never shrinks.
+ */
+void intHashMapSetLoadFactors(IntHashMap *map, float maxLoad, float minLoad)
+{
+    assert(map != 0);
+    probeTableSetLoadFactors(&map->table, maxLoad, minLoad);
+}
+
+/**
+ * Grows the table, if needed, so that it can hold the given number of keys
+ * without resizing.
+ * @param map
+ * @param count Number of keys the map should hold.
+ */
+void intHashMapReserve(IntHashMap *map, int count)
+{
+    assert(map != 0);
+    probeTableReserve(&map->table, count);
+}
+
+/**
+ * Shrinks the table to the smallest capacity that holds its keys.
+ * @param map
+ */
+void intHashMapShrinkToFit(IntHashMap *map)
+{
+    assert(map != 0);
+    probeTableShrinkToFit(&map->table);
+}
+
+/**
+ * Prepares an iterator over every key and value in the map, in table order.
+ * The map must not be modified while the iterator is in use.
+ * @param iterator
+ * @param map
+ */
+void intHashMapIteratorInit(IntHashMapIterator *iterator, IntHashMap *map)
+{
+    assert(map != 0);
+    iterator->map = map;
+    iterator->index = -1;
+}
+
+/**
+ * Advances the iterator to the next key.
+ * @param iterator
+ * @param key Set to the key.
+ * @param value Set to a pointer to the key's value.
+ * @return 1 if a key was found, 0 once every key has been visited.
+ */
+int intHashMapIteratorNext(IntHashMapIterator *iterator, uint64_t *key, int **value)
+{
+    IntHashMap *map = iterator->map;
+    while (++iterator->index < map->table.capacity)
+    {
+        IntSlot *slot = slotAt(map, iterator->index);
+        if (slot->probe.hash != 0)
+        {
+            *key = slot->key;
+            *value = &slot->value;
+            return 1;
+        }
+    }
+    return 0;
+}
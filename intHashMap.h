@@ -0,0 +1,52 @@
+#ifndef INT_HASH_MAP_H
+#define INT_HASH_MAP_H
+
+/*
+ * Hash map from 64-bit integers to ints. Keys are stored in the slots
+ * themselves and hashed with a few multiplies, so there is no string
+ * formatting, copying or comparing. Slots are probed linearly by a
+ * ProbeTable.
+ */
+
+#include "probeTable.h"
+
+typedef struct IntSlot IntSlot;
+typedef struct IntHashMap IntHashMap;
+typedef struct IntHashMapIterator IntHashMapIterator;
+
+struct IntSlot
+{
+    // Hash is 0 when the slot is empty; every key value is valid.
+    ProbeSlot probe;
+    uint64_t key;
+    int value;
+};
+
+struct IntHashMap
+{
+    ProbeTable table;
+};
+
+struct IntHashMapIterator
+{
+    IntHashMap* map;
+    int index;
+};
+
+IntHashMap* intHashMapNew(int capacity);
+void intHashMapDelete(IntHashMap* map);
+int* intHashMapGet(const IntHashMap* map, uint64_t key);
+void intHashMapPut(IntHashMap* map, uint64_t key, int value);
+int* intHashMapGetOrInsert(IntHashMap* map, uint64_t key, int value, int* inserted);
+int intHashMapRemove(IntHashMap* map, uint64_t key);
+int intHashMapContainsKey(const IntHashMap* map, uint64_t key);
+int intHashMapSize(const IntHashMap* map);
+int intHashMapCapacity(const IntHashMap* map);
+void intHashMapSetLoadFactors(IntHashMap* map, float maxLoad, float minLoad);
+void intHashMapReserve(IntHashMap* map, int count);
+void intHashMapShrinkToFit(IntHashMap* map);
+
+void intHashMapIteratorInit(IntHashMapIterator* iterator, IntHashMap* map);
+int intHashMapIteratorNext(IntHashMapIterator* iterator, uint64_t* key, int** value);
+
+#endif
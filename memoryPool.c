@@ -0,0 +1,225 @@
+/*
+ * CS 261 Data Structures
+ * Slab pool and bump arena for the hash map.
+ */
+
+#include "memoryPool.h"
+#include <stdlib.h>
+#include <assert.h>
+
+// Chunks are 8 byte aligned; block and slab headers keep that alignment.
+#define ALIGNMENT 8
+#define HEADER_SIZE ALIGNMENT
+// Largest chunk recycled through the size class free lists.
+#define LARGEST_CLASS (ARENA_CLASSES * ALIGNMENT)
+
+typedef struct LargeChunk LargeChunk;
+
+// Header of a chunk too large for the size classes; keeps 8 byte alignment.
+struct LargeChunk
+{
+    LargeChunk *next;
+    LargeChunk *prev;
+};
+
+static size_t alignUp(size_t size)
+{
+    return (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+}
+
+/**
+ * Allocates a block with room for the given number of bytes and pushes it on
+ * a list of blocks. The first word of each block links to the next one.
+ * @param list Head of the block list.
+ * @param size Usable bytes in the block.
+ * @return Start of the usable bytes.
+ */
+static char *blockNew(void **list, size_t size)
+{
+    char *block = malloc(HEADER_SIZE + size);
+    *(void **)block = *list;
+    *list = block;
+    return block + HEADER_SIZE;
+}
+
+/**
+ * Frees every block of a list.
+ */
+static void blocksFree(void *block)
+{
+    while (block != NULL)
+    {
+        void *next = *(void **)block;
+        free(block);
+        block = next;
+    }
+}
+
+/**
+ * Initializes an empty pool. No memory is allocated until the first object.
+ * @param pool
+ * @param objectSize Size of every object; rounded up to keep alignment.
+ * @param objectsPerSlab Number of objects allocated together.
+ */
+void poolInit(Pool *pool, size_t objectSize, int objectsPerSlab)
+{
+    assert(objectsPerSlab > 0);
+    pool->objectSize = alignUp(objectSize < sizeof(void *) ? sizeof(void *) : objectSize);
+    pool->objectsPerSlab = objectsPerSlab;
+    pool->slabs = NULL;
+    pool->freeList = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+}
+
+/**
+ * Returns an uninitialized object, reusing a freed one if possible.
+ * @param pool
+ * @return Object of the pool's object size.
+ */
+void *poolAlloc(Pool *pool)
+{
+    if (pool->freeList != NULL)
+    {
+        void *object = pool->freeList;
+        pool->freeList = *(void **)object;
+        return object;
+    }
+    if (pool->next == pool->end)
+    {
+        size_t slabSize = pool->objectSize * pool->objectsPerSlab;
+        pool->next = blockNew(&pool->slabs, slabSize);
+        pool->end = pool->next + slabSize;
+    }
+    void *object = pool->next;
+    pool->next += pool->objectSize;
+    return object;
+}
+
+/**
+ * Returns an object to the pool for reuse.
+ * @param pool
+ * @param object Object allocated from this pool.
+ */
+void poolFree(Pool *pool, void *object)
+{
+    *(void **)object = pool->freeList;
+    pool->freeList = object;
+}
+
+/**
+ * Frees every slab of the pool at once, including objects still in use, and
+ * leaves the pool empty and ready for reuse.
+ * @param pool
+ */
+void poolRelease(Pool *pool)
+{
+    blocksFree(pool->slabs);
+    poolInit(pool, pool->objectSize, pool->objectsPerSlab);
+}
+
+/**
+ * Initializes an empty arena. No memory is allocated until the first chunk.
+ * @param arena
+ * @param blockSize Bytes allocated at a time, at least the largest size class
+ *                  so that every class fits in a block.
+ */
+void arenaInit(Arena *arena, size_t blockSize)
+{
+    assert(blockSize >= LARGEST_CLASS);
+    arena->blockSize = blockSize;
+    arena->blocks = NULL;
+    arena->largeChunks = NULL;
+    for (int i = 0; i < ARENA_CLASSES; i++)
+    {
+        arena->freeLists[i] = NULL;
+    }
+    arena->next = NULL;
+    arena->end = NULL;
+}
+
+/**
+ * Returns an uninitialized chunk of at least the given size. Chunks larger
+ * than the largest size class are allocated on their own, so that freeing
+ * them returns their memory.
+ * @param arena
+ * @param size
+ * @return 8 byte aligned chunk.
+ */
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    size = alignUp(size == 0 ? 1 : size);
+    if (size > LARGEST_CLASS)
+    {
+        LargeChunk *chunk = malloc(sizeof(LargeChunk) + size);
+        chunk->next = arena->largeChunks;
+        chunk->prev = NULL;
+        if (chunk->next != NULL)
+        {
+            chunk->next->prev = chunk;
+        }
+        arena->largeChunks = chunk;
+        return chunk + 1;
+    }
+    void **freeList = &arena->freeLists[size / ALIGNMENT - 1];
+    if (*freeList != NULL)
+    {
+        void *chunk = *freeList;
+        *freeList = *(void **)chunk;
+        return chunk;
+    }
+    if (size > (size_t)(arena->end - arena->next))
+    {
+        arena->next = blockNew(&arena->blocks, arena->blockSize);
+        arena->end = arena->next + arena->blockSize;
+    }
+    void *chunk = arena->next;
+    arena->next += size;
+    return chunk;
+}
+
+/**
+ * Makes a chunk available for reuse by a later chunk of the same size class,
+ * or frees it if it is bigger than the largest class.
+ * @param arena
+ * @param chunk Chunk allocated from this arena.
+ * @param size The size the chunk was allocated with.
+ */
+void arenaFree(Arena *arena, void *chunk, size_t size)
+{
+    size = alignUp(size == 0 ? 1 : size);
+    if (size > LARGEST_CLASS)
+    {
+        LargeChunk *large = (LargeChunk *)chunk - 1;
+        if (large->prev != NULL)
+        {
+            large->prev->next = large->next;
+        }
+        else
+        {
+            arena->largeChunks = large->next;
+        }
+        if (large->next != NULL)
+        {
+            large->next->prev = large->prev;
+        }
+        free(large);
+        return;
+    }
+    void **freeList = &arena->freeLists[size / ALIGNMENT - 1];
+    *(void **)chunk = *freeList;
+    *freeList = chunk;
+}
+
+/**
+ * Frees every block of the arena at once and leaves it empty and ready for
+ * reuse.
+ * @param arena
+ */
+void arenaRelease(Arena *arena)
+{
+    blocksFree(arena->blocks);
+    // A large chunk's header starts with its next pointer, like a block's.
+    blocksFree(arena->largeChunks);
+    arenaInit(arena, arena->blockSize);
+}
@@ -0,0 +1,56 @@
+#ifndef MEMORY_POOL_H
+#define MEMORY_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Allocators owned by a hash map so that entries do not each cost a malloc
+ * call and an allocator header.
+ */
+
+// Size classes of recycled arena chunks: 8, 16, ..., 256 bytes.
+#define ARENA_CLASSES 32
+
+typedef struct Pool Pool;
+typedef struct Arena Arena;
+
+// Fixed-size objects carved from large slabs, recycled through a free list.
+struct Pool
+{
+    size_t objectSize;
+    int objectsPerSlab;
+    // Singly linked list of slabs, newest first.
+    void* slabs;
+    // Freed objects available for reuse.
+    void* freeList;
+    // Unused space at the end of the newest slab.
+    char* next;
+    char* end;
+};
+
+// Variable-size chunks bump allocated from large blocks. Freed chunks of up to
+// 256 bytes are recycled by size class; larger chunks are allocated and freed
+// one by one. Everything is released at once.
+struct Arena
+{
+    size_t blockSize;
+    void* blocks;
+    // Chunks over 256 bytes, each with a header linking it into a doubly
+    // linked list.
+    void* largeChunks;
+    void* freeLists[ARENA_CLASSES];
+    char* next;
+    char* end;
+};
+
+void poolInit(Pool* pool, size_t objectSize, int objectsPerSlab);
+void* poolAlloc(Pool* pool);
+void poolFree(Pool* pool, void* object);
+void poolRelease(Pool* pool);
+
+void arenaInit(Arena* arena, size_t blockSize);
+void* arenaAlloc(Arena* arena, size_t size);
+void arenaFree(Arena* arena, void* chunk, size_t size);
+void arenaRelease(Arena* arena);
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * CS 261 Data Structures
+ * Linear probing core shared by the tables with inline entries.
+ */
+
+#include "probeTable.h"
+#include "hashMap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Returns the slot at the given index.
+ */
+static ProbeSlot *slotAt(const ProbeTable *table, int index)
+{
+    return (ProbeSlot *)(table->slots + (size_t)index * table->slotSize);
+}
+
+/**
+ * Returns the first free slot of a hash's probe sequence.
+ */
+static int probeFree(const ProbeTable *table, uint64_t hash)
+{
+    int mask = table->capacity - 1;
+    int index = probeTableHome(table, hash);
+
+    while (slotAt(table, index)->hash != 0)
+    {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+/**
+ * Moves every slot into a table of the given capacity, which must hold them
+ * all. Slots are placed by their stored hash, so no key is rehashed. Resizing
+ * to the same capacity packs the clusters of a table left long by removes.
+ * @param table
+ * @param capacity The new number of slots, a power of two.
+ */
+void probeTableResize(ProbeTable *table, int capacity)
+{
+    assert(capacity > table->size && (capacity & (capacity - 1)) == 0);
+
+    char *oldSlots = table->slots;
+    int oldCapacity = table->capacity;
+
+    table->slots = calloc(capacity, table->slotSize);
+    table->capacity = capacity;
+    for (int i = 0; i < oldCapacity; i++)
+    {
+        ProbeSlot *slot = (ProbeSlot *)(oldSlots + (size_t)i * table->slotSize);
+        if (slot->hash != 0)
+        {
+            memcpy(slotAt(table, probeFree(table, slot->hash)), slot, table->slotSize);
+        }
+    }
+    free(oldSlots);
+}
+
+/**
+ * Turns a key's hash into the hash stored in its slot. Zero marks empty
+ * slots, so a zero hash is stored as one instead; keys are compared in full
+ * anyway.
+ * @param hash
+ * @return Nonzero hash.
+ */
+uint64_t probeHash(uint64_t hash)
+{
+    return hash != 0 ? hash : 1;
+}
+
+/**
+ * Returns the smallest power of two capacity, at least 2, that holds the
+ * given number of entries within the given load.
+ * @param count Number of entries.
+ * @param load Largest load.
+ * @return Capacity.
+ */
+int probeCapacity(int count, double load)
+{
+    int capacity = 2;
+    while (count > capacity * load)
+    {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/**
+ * Initializes an empty table with the default load factors of HashMap's
+ * linear probing engine.
+ * @param table
+ * @param count Number of entries the table should hold before it grows.
+ * @param slotSize Bytes of a slot, ProbeSlot included. Slots start at
+ * multiples of this size, so it must keep their fields aligned.
+ */
+void probeTableInit(ProbeTable *table, int count, size_t slotSize)
+{
+    assert(slotSize >= sizeof(ProbeSlot));
+
+    table->slotSize = slotSize;
+    table->size = 0;
+    table->maxLoad = MAX_PROBE_TABLE_LOAD;
+    table->minLoad = MIN_TABLE_LOAD;
+    table->growthFactor = GROWTH_FACTOR;
+    table->capacity = probeCapacity(count, table->maxLoad);
+    table->slots = calloc(table->capacity, slotSize);
+}
+
+/**
+ * Frees the slots of a table.
+ * @param table
+ */
+void probeTableRelease(ProbeTable *table)
+{
+    free(table->slots);
+    table->slots = NULL;
+}
+
+/**
+ * Returns the home slot of a hash, where its search starts. The hash is mixed
+ * first so that weak hash functions still spread across the table.
+ * @param table
+ * @param hash
+ * @return Slot index.
+ */
+int probeTableHome(const ProbeTable *table, uint64_t hash)
+{
+    return (int)((hash * 0x9E3779B97F4A7C15ull) >> 32) & (table->capacity - 1);
+}
+
+/**
+ * Finds the slot of a key.
+ * @param table
+ * @param hash Hash of the key from probeHash.
+ * @param key Passed to match.
+ * @param length Passed to match.
+ * @param match Compares the key with a slot whose hash matches.
+ * @param search Set to the free slot that ended a failed search and the work
+ * the search did, or NULL.
+ * @return Slot index, or -1 if the key is not in the table.
+ */
+int probeTableFind(const ProbeTable *table, uint64_t hash, const void *key, size_t length,
+                   ProbeMatch match, ProbeSearch *search)
+{
+    int mask = table->capacity - 1;
+    int index = probeTableHome(table, hash);
+    ProbeSlot *slot = slotAt(table, index);
+    int probes = 1;
+    int compares = 0;
+
+    while (slot->hash != 0)
+    {
+        if (slot->hash == hash)
+        {
+            compares++;
+            if (match(slot, key, length))
+            {
+                break;
+            }
+        }
+        index = (index + 1) & mask;
+        slot = slotAt(table, index);
+        probes++;
+    }
+    if (search != NULL)
+    {
+        search->freeIndex = slot->hash == 0 ? index : -1;
+        search->probes = probes;
+        search->compares = compares;
+    }
+    return slot->hash != 0 ? index : -1;
+}
+
+/**
+ * Claims a slot for a key that is not in the table, growing the table by its
+ * growth factor first if the key would take it past its maximum load. Only
+ * the slot's hash is set; the caller fills in the rest.
+ * @param table
+ * @param hash Hash of the key from probeHash.
+ * @param freeIndex Free slot found by probeTableFind for the key, or -1 to
+ * search for one.
+ * @return The claimed slot, valid until the table is next changed.
+ */
+ProbeSlot *probeTableInsert(ProbeTable *table, uint64_t hash, int freeIndex)
+{
+    assert(hash != 0);
+
+    if (table->size + 1 > table->capacity * table->maxLoad)
+    {
+        probeTableResize(table, table->capacity * table->growthFactor);
+        freeIndex = -1;
+    }
+    if (freeIndex < 0)
+    {
+        freeIndex = probeFree(table, hash);
+    }
+    ProbeSlot *slot = slotAt(table, freeIndex);
+    slot->hash = hash;
+    table->size++;
+    return slot;
+}
+
+/**
+ * Empties the slot at the given index, shifting later slots of the same
+ * cluster back so that no probe sequence is broken by the new hole. A table
+ * left below its minimum load is shrunk, leaving room to grow by the growth
+ * factor before it reaches the maximum load again.
+ * @param table
+ * @param index Index of a full slot.
+ */
+void probeTableErase(ProbeTable *table, int index)
+{
+    int mask = table->capacity - 1;
+    int next = (index + 1) & mask;
+
+    while (slotAt(table, next)->hash != 0)
+    {
+        int home = probeTableHome(table, slotAt(table, next)->hash);
+        if (((next - home) & mask) >= ((next - index) & mask))
+        {
+            memcpy(slotAt(table, index), slotAt(table, next), table->slotSize);
+            index = next;
+        }
+        next = (next + 1) & mask;
+    }
+    slotAt(table, index)->hash = 0;
+    table->size--;
+
+    if (table->size < table->capacity * table->minLoad)
+    {
+        int capacity = probeCapacity(table->size, table->maxLoad / table->growthFactor);
+        if (capacity < table->capacity)
+        {
+            probeTableResize(table, capacity);
+        }
+    }
+}
+
+/**
+ * Grows the table, if needed, so that it can hold the given number of entries
+ * without resizing.
+ * @param table
+ * @param count Number of entries the table should hold.
+ */
+void probeTableReserve(ProbeTable *table, int count)
+{
+    int capacity = probeCapacity(count, table->maxLoad);
+    if (capacity > table->capacity)
+    {
+        probeTableResize(table, capacity);
+    }
+}
+
+/**
+ * Shrinks the table to the smallest capacity that holds its entries.
+ * @param table
+ */
+void probeTableShrinkToFit(ProbeTable *table)
+{
+    int capacity = probeCapacity(table->size, table->maxLoad);
+    if (capacity < table->capacity)
+    {
+        probeTableResize(table, capacity);
+    }
+}
+
+/**
+ * Sets the loads the table is kept between, as hashMapSetLoadFactors does for
+ * a linear probing HashMap.
+ * @param table
+ * @param maxLoad Largest load, below 1.
+ * @param minLoad Smallest load, below maxLoad divided by the growth factor; 0
+ * never shrinks.
+ */
+void probeTableSetLoadFactors(ProbeTable *table, float maxLoad, float minLoad)
+{
+    assert(maxLoad > 0 && maxLoad < 1);
+    assert(minLoad >= 0 && minLoad * table->growthFactor < maxLoad);
+
+    table->maxLoad = maxLoad;
+    table->minLoad = minLoad;
+    probeTableReserve(table, table->size);
+}
+
+/**
+ * Sets the factor a full table grows by, a power of two of at least 2.
+ * @param table
+ * @param growthFactor
+ */
+void probeTableSetGrowthFactor(ProbeTable *table, int growthFactor)
+{
+    assert(growthFactor >= 2 && (growthFactor & (growthFactor - 1)) == 0);
+    assert(table->minLoad * growthFactor < table->maxLoad);
+    table->growthFactor = growthFactor;
+}
@@ -0,0 +1,73 @@
+#ifndef PROBE_TABLE_H
+#define PROBE_TABLE_H
+
+/*
+ * Linear probing core of the tables that keep their entries inline:
+ * ValueHashMap, IntHashMap, HashMap's HASH_MAP_LINEAR_PROBING engine and the
+ * slots of a snapshot file. A table is an array of slots of a size chosen by
+ * the map, each starting with a ProbeSlot; the rest of a slot is the map's
+ * own. The core places slots by their hash, keeps the table between its load
+ * factors and removes by shifting later slots back, so no deleted markers
+ * are needed. Maps compare their own keys through a ProbeMatch.
+ *
+ * Where a slot's search starts is part of the snapshot file format, so
+ * probeTableHome must not change without a new snapshot version.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ProbeSlot ProbeSlot;
+typedef struct ProbeTable ProbeTable;
+typedef struct ProbeSearch ProbeSearch;
+
+// Returns nonzero if the key of a slot whose hash matched is the given key.
+typedef int (*ProbeMatch)(const ProbeSlot* slot, const void* key, size_t length);
+
+struct ProbeSlot
+{
+    // Hash of the slot's key from probeHash, or 0 if the slot is empty.
+    uint64_t hash;
+};
+
+// What a probeTableFind saw on the way to its result.
+struct ProbeSearch
+{
+    // Free slot that ended a failed search, where probeTableInsert can put
+    // the key.
+    int freeIndex;
+    // Slots visited, and keys compared because their hash matched.
+    int probes;
+    int compares;
+};
+
+struct ProbeTable
+{
+    // Slots of slotSize bytes each.
+    char* slots;
+    size_t slotSize;
+    int size;
+    // Number of slots, a power of two.
+    int capacity;
+    // See probeTableSetLoadFactors and probeTableSetGrowthFactor.
+    float maxLoad;
+    float minLoad;
+    int growthFactor;
+};
+
+uint64_t probeHash(uint64_t hash);
+int probeCapacity(int count, double load);
+void probeTableInit(ProbeTable* table, int count, size_t slotSize);
+void probeTableRelease(ProbeTable* table);
+int probeTableHome(const ProbeTable* table, uint64_t hash);
+int probeTableFind(const ProbeTable* table, uint64_t hash, const void* key, size_t length,
+                   ProbeMatch match, ProbeSearch* search);
+ProbeSlot* probeTableInsert(ProbeTable* table, uint64_t hash, int freeIndex);
+void probeTableErase(ProbeTable* table, int index);
+void probeTableResize(ProbeTable* table, int capacity);
+void probeTableReserve(ProbeTable* table, int count);
+void probeTableShrinkToFit(ProbeTable* table);
+void probeTableSetLoadFactors(ProbeTable* table, float maxLoad, float minLoad);
+void probeTableSetGrowthFactor(ProbeTable* table, int growthFactor);
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * CS 261 Data Structures
+ * Hash map split into independently locked shards.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "shardedHashMap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Returns the shard of a hash. Shards are picked by the top bits of the hash,
+ * while the shards place keys by the low bits or by a mix of all of them, so
+ * keys of one shard still spread over its whole table. The shards hash keys
+ * the same way, so the hash is passed on to them rather than computed again.
+ */
+static HashMapShard *shardFor(ShardedHashMap *map, uint64_t hash)
+{
+    if (map->shardBits == 0)
+    {
+        return &map->shards[0];
+    }
+    return &map->shards[hash >> (64 - map->shardBits)];
+}
+
+/**
+ * Hashes a key the way the shards do.
+ */
+static uint64_t shardedHash(const ShardedHashMap *map, const char *key, size_t length)
+{
+    return map->hashFunction(key, length, map->seed);
+}
+
+/**
+ * Creates a sharded map.
+ * @param capacity The initial number of buckets, split across the shards.
+ * @param shardCount Number of shards, rounded up to a power of two.
+ * @param engine Table layout of every shard.
+ * @return The allocated map, or NULL if the shards can't be allocated.
+ */
+ShardedHashMap *shardedHashMapNew(int capacity, int shardCount, HashMapEngine engine)
+{
+    assert(engine != HASH_MAP_SNAPSHOT);
+
+    ShardedHashMap *map = malloc(sizeof(ShardedHashMap));
+    map->hashFunction = HASH_FUNCTION;
+    map->seed = HASH_SEED;
+    map->shardCount = 1;
+    map->shardBits = 0;
+    while (map->shardCount < shardCount)
+    {
+        map->shardCount *= 2;
+        map->shardBits++;
+    }
+    int shardCapacity = (capacity + map->shardCount - 1) / map->shardCount;
+
+    void *shards;
+    if (posix_memalign(&shards, CACHE_LINE_SIZE, sizeof(HashMapShard) * map->shardCount) != 0)
+    {
+        free(map);
+        return NULL;
+    }
+    map->shards = shards;
+    for (int i = 0; i < map->shardCount; i++)
+    {
+        pthread_mutex_init(&map->shards[i].lock, NULL);
+        map->shards[i].map = hashMapNewEngine(shardCapacity > 0 ? shardCapacity : 1, engine);
+    }
+    return map;
+}
+
+/**
+ * Frees every shard and the map itself. No other thread may be using the map.
+ * @param map
+ */
+void shardedHashMapDelete(ShardedHashMap *map)
+{
+    for (int i = 0; i < map->shardCount; i++)
+    {
+        hashMapDelete(map->shards[i].map);
+        pthread_mutex_destroy(&map->shards[i].lock);
+    }
+    free(map->shards);
+    free(map);
+}
+
+/**
+ * Looks a key up. The value is copied out, since a pointer into a shard could
+ * be moved by another thread's insert as soon as the lock is released.
+ * @param map
+ * @param key
+ * @param value Set to the key's value if it is found.
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int shardedHashMapGet(ShardedHashMap *map, const char *key, int *value)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    size_t length = strlen(key);
+    uint64_t hash = shardedHash(map, key, length);
+    HashMapShard *shard = shardFor(map, hash);
+    pthread_mutex_lock(&shard->lock);
+    int *found = hashMapGetHashed(shard->map, key, length, hash);
+    if (found != NULL)
+    {
+        *value = *found;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return found != NULL;
+}
+
+/**
+ * Updates the given key-value pair, or adds it if the key is not in the map.
+ * Only the key's shard is locked, including while it resizes.
+ * @param map
+ * @param key
+ * @param value
+ */
+void shardedHashMapPut(ShardedHashMap *map, const char *key, int value)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    size_t length = strlen(key);
+    uint64_t hash = shardedHash(map, key, length);
+    HashMapShard *shard = shardFor(map, hash);
+    pthread_mutex_lock(&shard->lock);
+    *hashMapGetOrInsertHashed(shard->map, key, length, hash, value, NULL) = value;
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * Puts every key of an array in the map with the same value, as if by
+ * shardedHashMapPut. The keys are hashed and grouped by shard, so each shard
+ * is locked once and fills its whole group with hashMapPutBatchHashed.
+ * @param map
+ * @param keys
+ * @param count Number of keys.
+ * @param value Value for every key.
+ */
+void shardedHashMapPutBatch(ShardedHashMap *map, const char **keys, int count, int value)
+{
+    assert(map != 0);
+    assert(count == 0 || keys != 0);
+
+    int *shardOf = malloc(sizeof(int) * count);
+    size_t *lengths = malloc(sizeof(size_t) * count);
+    uint64_t *hashes = malloc(sizeof(uint64_t) * count);
+    int *start = calloc(map->shardCount + 1, sizeof(int));
+    const char **grouped = malloc(sizeof(char *) * count);
+    size_t *groupedLengths = malloc(sizeof(size_t) * count);
+    uint64_t *groupedHashes = malloc(sizeof(uint64_t) * count);
+
+    // Group the keys by shard with a counting sort.
+    for (int i = 0; i < count; i++)
+    {
+        lengths[i] = strlen(keys[i]);
+        hashes[i] = shardedHash(map, keys[i], lengths[i]);
+        shardOf[i] = (int)(shardFor(map, hashes[i]) - map->shards);
+        start[shardOf[i] + 1]++;
+    }
+    for (int s = 0; s < map->shardCount; s++)
+    {
+        start[s + 1] += start[s];
+    }
+    for (int i = 0; i < count; i++)
+    {
+        int at = start[shardOf[i]]++;
+        grouped[at] = keys[i];
+        groupedLengths[at] = lengths[i];
+        groupedHashes[at] = hashes[i];
+    }
+
+    // Each start now holds the end of its group, which is where the next
+    // group begins.
+    int first = 0;
+    for (int s = 0; s < map->shardCount; s++)
+    {
+        if (start[s] > first)
+        {
+            pthread_mutex_lock(&map->shards[s].lock);
+            hashMapPutBatchHashed(map->shards[s].map, grouped + first, groupedLengths + first,
+                                  groupedHashes + first, start[s] - first, value);
+            pthread_mutex_unlock(&map->shards[s].lock);
+        }
+        first = start[s];
+    }
+
+    free(groupedHashes);
+    free(groupedLengths);
+    free(grouped);
+    free(start);
+    free(hashes);
+    free(lengths);
+    free(shardOf);
+}
+
+/**
+ * Removes the given key from the map. If the key is not in the map, this does
+ * nothing.
+ * @param map
+ * @param key
+ */
+void shardedHashMapRemove(ShardedHashMap *map, const char *key)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    size_t length = strlen(key);
+    uint64_t hash = shardedHash(map, key, length);
+    HashMapShard *shard = shardFor(map, hash);
+    pthread_mutex_lock(&shard->lock);
+    hashMapRemoveHashed(shard->map, key, length, hash);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/**
+ * Returns 1 if the given key is in the map and 0 otherwise.
+ * @param map
+ * @param key
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int shardedHashMapContainsKey(ShardedHashMap *map, const char *key)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    size_t length = strlen(key);
+    uint64_t hash = shardedHash(map, key, length);
+    HashMapShard *shard = shardFor(map, hash);
+    pthread_mutex_lock(&shard->lock);
+    int found = hashMapContainsKeyHashed(shard->map, key, length, hash);
+    pthread_mutex_unlock(&shard->lock);
+    return found;
+}
+
+/**
+ * Adds up a statistic of every shard, reading each under its lock. While
+ * other threads write, the total mixes shards read at different times.
+ */
+static int shardTotal(ShardedHashMap *map, int (*statistic)(const HashMap *))
+{
+    assert(map != 0);
+
+    int total = 0;
+    for (int i = 0; i < map->shardCount; i++)
+    {
+        pthread_mutex_lock(&map->shards[i].lock);
+        total += statistic(map->shards[i].map);
+        pthread_mutex_unlock(&map->shards[i].lock);
+    }
+    return total;
+}
+
+/**
+ * Returns the number of keys in every shard.
+ * @param map
+ * @return Number of keys.
+ */
+int shardedHashMapSize(ShardedHashMap *map)
+{
+    return shardTotal(map, hashMapSize);
+}
+
+/**
+ * Returns the number of buckets in every shard.
+ * @param map
+ * @return Number of buckets.
+ */
+int shardedHashMapCapacity(ShardedHashMap *map)
+{
+    return shardTotal(map, hashMapCapacity);
+}
+
+/**
+ * Returns the number of empty buckets in every shard.
+ * @param map
+ * @return Number of empty buckets.
+ */
+int shardedHashMapEmptyBuckets(ShardedHashMap *map)
+{
+    return shardTotal(map, hashMapEmptyBuckets);
+}
+
+/**
+ * Returns the ratio of keys to buckets over all shards.
+ * @param map
+ * @return Table load.
+ */
+float shardedHashMapTableLoad(ShardedHashMap *map)
+{
+    assert(map != 0);
+
+    int size = 0;
+    int capacity = 0;
+    for (int i = 0; i < map->shardCount; i++)
+    {
+        pthread_mutex_lock(&map->shards[i].lock);
+        size += hashMapSize(map->shards[i].map);
+        capacity += hashMapCapacity(map->shards[i].map);
+        pthread_mutex_unlock(&map->shards[i].lock);
+    }
+    return size / (float)capacity;
+}
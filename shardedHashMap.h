@@ -0,0 +1,50 @@
+#ifndef SHARDED_HASH_MAP_H
+#define SHARDED_HASH_MAP_H
+
+/*
+ * Hash map for many writer threads, split by the high bits of the key's hash
+ * into independent HashMap shards. Each shard has its own lock and resizes on
+ * its own, so a resize only holds up the keys of one shard.
+ */
+
+#include "hashMap.h"
+#include "cacheLine.h"
+#include <pthread.h>
+
+typedef struct HashMapShard HashMapShard;
+typedef struct ShardedHashMap ShardedHashMap;
+
+// Shards are cache line aligned, which keeps the locks of neighbouring
+// shards on separate lines.
+struct HashMapShard
+{
+    pthread_mutex_t lock CACHE_ALIGNED;
+    HashMap* map;
+};
+
+struct ShardedHashMap
+{
+    // Picks the shard of a key; the shards use the same function and seed.
+    HashFunction hashFunction;
+    uint64_t seed;
+    // Number of shards, a power of two.
+    int shardCount;
+    int shardBits;
+    HashMapShard* shards;
+};
+
+ShardedHashMap* shardedHashMapNew(int capacity, int shardCount, HashMapEngine engine);
+void shardedHashMapDelete(ShardedHashMap* map);
+int shardedHashMapGet(ShardedHashMap* map, const char* key, int* value);
+void shardedHashMapPut(ShardedHashMap* map, const char* key, int value);
+void shardedHashMapPutBatch(ShardedHashMap* map, const char** keys, int count, int value);
+void shardedHashMapRemove(ShardedHashMap* map, const char* key);
+int shardedHashMapContainsKey(ShardedHashMap* map, const char* key);
+
+// Totals over every shard, each shard read under its lock.
+int shardedHashMapSize(ShardedHashMap* map);
+int shardedHashMapCapacity(ShardedHashMap* map);
+int shardedHashMapEmptyBuckets(ShardedHashMap* map);
+float shardedHashMapTableLoad(ShardedHashMap* map);
+
+#endif
@@ -1,70 +1,163 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "hashMap.h"
+#include "frozenMap.h"
+#include "editDistance.h"
+#include "topK.h"
+#include "suggestions.h"
+#include "wordScanner.h"
+#include "documentChecker.h"
 #include <assert.h>
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DICTIONARY_PATH "dictionary.txt"
+// Frozen dictionary saved by frozenMapSave, rebuilt whenever the dictionary
+// is newer.
+#define SNAPSHOT_PATH "dictionary.snapshot"
 
-// Required by Levenshtein calculation.
-#define MIN3(a, b, c) ((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
+/**
+ * Inserts every word of a buffer into the hash map with one hashMapPutBatch
+ * call. The words are terminated in place, so the buffer needs one spare byte
+ * after its length.
+ * @param buffer
+ * @param length Number of bytes of text in the buffer.
+ * @param map
+ */
+void loadDictionaryBuffer(char *buffer, size_t length, HashMap *map)
+{
+    int count;
+    char **words = splitWords(buffer, length, &count);
+    hashMapPutBatch(map, (const char **)words, count, -1);
+    free(words);
+}
 
 /**
- * Allocates a string for the next word in the file and returns it. This string
- * is null terminated. Returns NULL after reaching the end of the file.
+ * Loads the contents of the file into the hash map. The whole file is read in
+ * large blocks and its words are inserted with one hashMapPutBatch call.
  * @param file
- * @return Allocated string or NULL.
+ * @param map
  */
-char *nextWord(FILE *file)
+void loadDictionary(FILE *file, HashMap *map)
 {
-    int maxLength = 16;
-    int length = 0;
-    char *word = malloc(sizeof(char) * maxLength);
-    while (1)
+    size_t maxLength = 64 * 1024;
+    size_t length = 0;
+    size_t bytesRead;
+    char *buffer = malloc(maxLength);
+
+    // Keep one byte spare for the last terminator.
+    while ((bytesRead = fread(buffer + length, 1, maxLength - length - 1, file)) > 0)
     {
-        char c = fgetc(file);
-        if ((c >= '0' && c <= '9') ||
-            (c >= 'A' && c <= 'Z') ||
-            (c >= 'a' && c <= 'z') ||
-            c == '\'')
+        length += bytesRead;
+        if (length + 1 == maxLength)
         {
-            if (length + 1 >= maxLength)
-            {
-                maxLength *= 2;
-                word = realloc(word, maxLength);
-            }
-            word[length] = c;
-            length++;
-        }
-        else if (length > 0 || c == EOF)
-        {
-            break;
+            maxLength *= 2;
+            buffer = realloc(buffer, maxLength);
         }
     }
-    if (length == 0)
+    loadDictionaryBuffer(buffer, length, map);
+    free(buffer);
+}
+
+/**
+ * Maps a dictionary file into memory copy-on-write, so its words can be
+ * terminated in place and used as keys without copying them. The mapping is
+ * one byte longer than the file for the last terminator; that byte is only
+ * backed by memory when the file does not end on a page boundary.
+ * @param path
+ * @param length Set to the length of the file.
+ * @return The mapping, or NULL if the file can't be mapped this way.
+ */
+char *mapDictionary(const char *path, size_t *length)
+{
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
     {
-        free(word);
         return NULL;
     }
-    word[length] = '\0';
-    return word;
+    if (fstat(fd, &info) != 0 || info.st_size == 0 ||
+        info.st_size % sysconf(_SC_PAGESIZE) == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    *length = info.st_size;
+    char *mapped = mmap(NULL, *length + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return NULL;
+    }
+    posix_madvise(mapped, *length, POSIX_MADV_SEQUENTIAL);
+    return mapped;
 }
 
 /**
- * Loads the contents of the file into the hash map.
- * @param file
- * @param map
+ * Returns true if the file at path exists and was modified no earlier than
+ * the file at otherPath.
  */
-void loadDictionary(FILE *file, HashMap *map)
+int isNewer(const char *path, const char *otherPath)
 {
-    char *word = nextWord(file);
+    struct stat info;
+    struct stat otherInfo;
 
-    while (word != NULL)
+    if (stat(path, &info) != 0 || stat(otherPath, &otherInfo) != 0)
     {
-        hashMapPut(map, word, -1);
-        free(word);
-        word = nextWord(file);
+        return 0;
+    }
+    return info.st_mtime >= otherInfo.st_mtime;
+}
+
+/**
+ * Loads the dictionary into a hash map and freezes it. Queries only read the
+ * dictionary, so the frozen map holds copies of the keys, and the table and
+ * mapping are released.
+ * @param stats Nonzero to write the shape and counters of the table to
+ *              standard error as JSON.
+ * @return The frozen dictionary, or NULL if it can't be built.
+ */
+FrozenMap *buildDictionary(int stats)
+{
+    HashMap *map = hashMapNewEngine(1000, HASH_MAP_GROUP_PROBING);
+    // Keys point into the mapped dictionary when it can be mapped, so it
+    // must stay mapped until the map is frozen.
+    size_t mappedLength = 0;
+    char *mapped = mapDictionary(DICTIONARY_PATH, &mappedLength);
+
+    hashMapSetStats(map, stats);
+    if (mapped != NULL)
+    {
+        hashMapSetBorrowedKeys(map, 1);
+        loadDictionaryBuffer(mapped, mappedLength, map);
+    }
+    else
+    {
+        FILE *file = fopen(DICTIONARY_PATH, "r");
+        loadDictionary(file, map);
+        fclose(file);
+    }
+
+    FrozenMap *dictionary = frozenMapNew(map);
+    if (stats)
+    {
+        hashMapPrintStatsJson(map, stderr);
     }
+    hashMapDelete(map);
+    if (mapped != NULL)
+    {
+        munmap(mapped, mappedLength + 1);
+    }
+    return dictionary;
 }
 
 /**
@@ -148,133 +241,243 @@ void getString(char *input)
 }
 
 /**
- * Compares two strings and calculates their Leveinshtein distance.
+ * Looks the given string up in the dictionary. Returns true if an exact match
+ * is found.
  */
-int levenshtein(char *s1, char *s2)
+int findMatch(const FrozenMap *map, char *word)
 {
-    unsigned int s1len, s2len, x, y, lastdiag, olddiag;
-    s1len = strlen(s1);
-    s2len = strlen(s2);
-    unsigned int column[s1len + 1];
-    for (y = 1; y <= s1len; y++)
-        column[y] = y;
-    for (x = 1; x <= s2len; x++)
+    return frozenMapContainsKey(map, word);
+}
+
+/**
+ * Finds the words in the map with the lowest Levenshtein distance to the
+ * given string. A deletion index of the map, built by the first call, finds
+ * the words within two edits; fewer than size of them are topped up by
+ * comparing with every word in the map.
+ * @param map to traverse
+ * @param word misspelled word
+ * @param relatedWords an array to store the words, nearest first
+ * @param size number of words to find
+ * @param pool threads to compare with
+ * @param index deletion index of the map, or NULL until the first call
+ * @return number of words found
+ */
+int findRelatedWords(const FrozenMap *map, char *word, char **relatedWords, int size,
+                     SuggestionPool *pool, SuggestionIndex **index)
+{
+    TopK nearest;
+
+    if (*index == NULL)
     {
-        column[0] = x;
-        for (y = 1, lastdiag = x - 1; y <= s1len; y++)
-        {
-            olddiag = column[y];
-            column[y] = MIN3(column[y] + 1, column[y - 1] + 1, lastdiag + (s1[y - 1] == s2[x - 1] ? 0 : 1));
-            lastdiag = olddiag;
-        }
+        *index = suggestionIndexNew(map);
     }
-    return (column[s1len]);
+    topKInit(&nearest, size);
+    suggestionIndexQuery(*index, pool, word, INT_MAX, &nearest);
+    int found = topKSorted(&nearest, (const char **)relatedWords, NULL);
+    topKRelease(&nearest);
+    return found;
 }
 
 /**
- * Compares the given string to each word in the dictionary. If an exact match is found, the 
- * function returns true. If the word is not a match, calculates the Levenshtein distance 
- * and assigns that value for the key in the table. If the entire table is traversed and no 
- * match is found, returns false.
+ * Suggestion settings and results shared by the misspellings of a document.
  */
-int findMatch(HashMap *map, char *word)
+typedef struct DocumentReport DocumentReport;
+
+struct DocumentReport
 {
-    HashLink *current;
+    const FrozenMap *dictionary;
+    SuggestionPool *pool;
+    // Built by the first misspelling, so that documents without any don't
+    // pay for it.
+    SuggestionIndex *index;
+    char **relatedWords;
+    int numberOfRelatedWords;
+    // Index in suggestionLines of every misspelled word seen so far, since
+    // documents tend to repeat their misspellings.
+    HashMap *seen;
+    char **suggestionLines;
+    int lineCount;
+    int lineCapacity;
+    long long misspelled;
+};
 
-    for (int i = 0, cap = map->capacity; i < cap; i++)
+/**
+ * Prints a misspelled word of a document with its byte offset and its
+ * suggestions, separated by tabs. Suggestions are only searched for the first
+ * time a word is seen.
+ */
+void reportMisspelling(const char *word, long long offset, void *context)
+{
+    DocumentReport *report = context;
+    int inserted;
+    int *line = hashMapGetOrInsert(report->seen, word, report->lineCount, &inserted);
+
+    if (inserted)
     {
-        current = map->table[i];
-        while (current != NULL)
+        int found = findRelatedWords(report->dictionary, (char *)word, report->relatedWords,
+                                     report->numberOfRelatedWords, report->pool,
+                                     &report->index);
+        size_t length = 1;
+        for (int i = 0; i < found; i++)
         {
-            // Exact match is found, return true.
-            if (strcmp((current->key), word) == 0)
-            {
-                return 1;
-            }
-            // Assign Lev distance and move on to next word.
-            else
-            {
-                current->value = levenshtein(word, current->key);
-                current = current->next;
-            }
+            length += strlen(report->relatedWords[i]) + 1;
+        }
+        char *suggestions = malloc(length);
+        suggestions[0] = '\0';
+        for (int i = 0; i < found; i++)
+        {
+            strcat(suggestions, i == 0 ? "" : ",");
+            strcat(suggestions, report->relatedWords[i]);
         }
+        if (report->lineCount == report->lineCapacity)
+        {
+            report->lineCapacity *= 2;
+            report->suggestionLines = realloc(report->suggestionLines,
+                                              sizeof(char *) * report->lineCapacity);
+        }
+        report->suggestionLines[report->lineCount++] = suggestions;
     }
-    return 0;
+    printf("%lld\t%s\t%s\n", offset, word, report->suggestionLines[*line]);
+    report->misspelled++;
 }
 
 /**
- * Traverses the given map, maintaining an array of 5 words with the 
- * lowest Levenshtein distance.
- * @param map to traverse
- * @param relatedWords an array to store the words
+ * Spell checks a whole document and prints every misspelled word, one per
+ * line, as described at reportMisspelling.
+ * @param path File to check, or "-" for standard input.
+ * @return 0 on success, 1 if the file can't be read.
  */
-void findRelatedWords(HashMap *map, char **relatedWords, int size)
+int checkDocumentFile(const char *path, DocumentReport *report)
 {
-    HashLink *current;
-    int maxIndex = size - 1;
-    int indexToAdd = 0;
-    int currentMax = 1000;
-
-    for (int i = 0, cap = map->capacity; i < cap; i++)
+    FILE *input = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (input == NULL)
     {
-        current = map->table[i];
-        while (current != NULL)
-        {
-            // Fill the array with words because the array is empty.
-            if (i < size)
-            {
-                relatedWords[indexToAdd] = current->key;
-                if (current->value <= currentMax)
-                {
-                    currentMax = current->value;
-                }
-                indexToAdd++;
-            }
-            // Only add the word if the value <= currentMax.
-            else
-            {
-                if (current->value <= currentMax)
-                {
-                    relatedWords[indexToAdd] = current->key;
-                    currentMax = current->value;
-                    indexToAdd++;
-                }
-            }
+        fprintf(stderr, "Could not open %s\n", path);
+        return 1;
+    }
 
-            // Reset the index to start over once the end of the array is reached.
-            if (indexToAdd > maxIndex)
-            {
-                indexToAdd = 0;
-            }
-            current = current->next;
-        }
+    clock_t timer = clock();
+    long long checked = checkDocument(input, report->dictionary, reportMisspelling, report);
+    timer = clock() - timer;
+    if (input != stdin)
+    {
+        fclose(input);
     }
+    if (checked < 0)
+    {
+        fprintf(stderr, "Could not read %s\n", path);
+        return 1;
+    }
+    fprintf(stderr, "Checked %lld words, %lld misspelled, in %f seconds\n", checked,
+            report->misspelled, (float)timer / (float)CLOCKS_PER_SEC);
+    return 0;
 }
 
 /**
  * Checks the spelling of the word provded by the user. If the word is spelled incorrectly,
  * print the 5 closest words as determined by a metric like the Levenshtein distance.
  * Otherwise, indicate that the provded word is spelled correctly. Use dictionary.txt to
- * create the dictionary.
+ * create the dictionary. Suggestions come from a deletion index of the
+ * dictionary, or, for words with few close matches, from comparing every
+ * dictionary word, with --threads N threads (0 for one per processor).
+ * --check FILE checks a whole document ("-" for standard input) instead of
+ * prompting for words. --stats writes the shape and counters of the
+ * dictionary table to standard error as JSON, building the table even when a
+ * snapshot of the frozen dictionary could be loaded instead.
  * @param argc
  * @param argv
  * @return
  */
 int main(int argc, const char **argv)
 {
-    HashMap *map = hashMapNew(1000);
+    int threads = 1;
+    const char *checkPath = NULL;
+    int stats = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = atoi(argv[++i]);
+            if (threads <= 0)
+            {
+                threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            }
+        }
+        else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc)
+        {
+            checkPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            stats = 1;
+        }
+    }
     int numberOfRelatedWords = 5;
     char **relatedWords = malloc(sizeof(char *) * numberOfRelatedWords);
 
-    FILE *file = fopen("dictionary.txt", "r");
+    // A saved frozen dictionary is mapped and queried in place, skipping both
+    // the table and the freeze.
+    FrozenMap *dictionary = NULL;
     clock_t timer = clock();
-    loadDictionary(file, map);
+    if (!stats && isNewer(SNAPSHOT_PATH, DICTIONARY_PATH))
+    {
+        dictionary = frozenMapLoad(SNAPSHOT_PATH);
+    }
+    if (dictionary == NULL)
+    {
+        dictionary = buildDictionary(stats);
+        // Save a snapshot so the next run can skip building the dictionary.
+        // If this fails the next run simply builds it again.
+        if (dictionary != NULL)
+        {
+            frozenMapSave(dictionary, SNAPSHOT_PATH);
+        }
+    }
     timer = clock() - timer;
-    printf("Dictionary loaded in %f seconds\n", (float)timer / (float)CLOCKS_PER_SEC);
-    fclose(file);
+    if (dictionary == NULL)
+    {
+        printf("Could not build the dictionary\n");
+        free(relatedWords);
+        return 1;
+    }
+    // A checked document's report goes to standard output on its own.
+    fprintf(checkPath != NULL ? stderr : stdout, "Dictionary loaded in %f seconds\n",
+            (float)timer / (float)CLOCKS_PER_SEC);
+    // Started once, so that queries don't each start their threads.
+    SuggestionPool *pool = suggestionPoolNew(threads);
+
+    if (checkPath != NULL)
+    {
+        DocumentReport report = {
+            .dictionary = dictionary,
+            .pool = pool,
+            .index = NULL,
+            .relatedWords = relatedWords,
+            .numberOfRelatedWords = numberOfRelatedWords,
+        };
+        report.seen = hashMapNewEngine(64, HASH_MAP_GROUP_PROBING);
+        report.lineCapacity = 64;
+        report.suggestionLines = malloc(sizeof(char *) * report.lineCapacity);
+        int status = checkDocumentFile(checkPath, &report);
+        for (int i = 0; i < report.lineCount; i++)
+        {
+            free(report.suggestionLines[i]);
+        }
+        free(report.suggestionLines);
+        hashMapDelete(report.seen);
+        if (report.index != NULL)
+        {
+            suggestionIndexDelete(report.index);
+        }
+        suggestionPoolDelete(pool);
+        free(relatedWords);
+        frozenMapDelete(dictionary);
+        return status;
+    }
 
     char inputBuffer[256];
     int quit = 0;
+    SuggestionIndex *index = NULL;
 
     while (!quit)
     {
@@ -287,17 +490,18 @@ int main(int argc, const char **argv)
             quit = 1;
         }
         // Case 2: Input matches word found in dictionary.
-        else if (findMatch(map, inputBuffer))
+        else if (findMatch(dictionary, inputBuffer))
         {
             printf("The inputted word, \"%s\" is spelled correctly.\n\n", inputBuffer);
         }
         // Case 3: Input is spelled incorrectly. Find and print related words.
         else
         {
-            findRelatedWords(map, relatedWords, numberOfRelatedWords);
+            int found = findRelatedWords(dictionary, inputBuffer, relatedWords,
+                                         numberOfRelatedWords, pool, &index);
             printf("The inputted word \"%s\" is spelled incorrectly.\n", inputBuffer);
             printf("Did you mean ...\n");
-            for (int i = 0; i < numberOfRelatedWords; i++)
+            for (int i = 0; i < found; i++)
             {
                 printf("    %s\n", relatedWords[i]);
             }
@@ -305,7 +509,12 @@ int main(int argc, const char **argv)
         }
     }
 
+    if (index != NULL)
+    {
+        suggestionIndexDelete(index);
+    }
+    suggestionPoolDelete(pool);
     free(relatedWords);
-    hashMapDelete(map);
+    frozenMapDelete(dictionary);
     return 0;
 }
@@ -0,0 +1,619 @@
+/*
+ * CS 261 Data Structures
+ * Suggestions from a full scan of a dictionary or from a deletion index.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "suggestions.h"
+#include "editDistance.h"
+#include "hashMap.h"
+#include "wordScanner.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct ScanTask ScanTask;
+typedef struct PoolWorker PoolWorker;
+typedef struct SortedWord SortedWord;
+
+// More than the deletion strings of one word, which has one per subset of
+// the characters of its prefix.
+#define MAX_DELETES (1 << SUGGESTION_INDEX_PREFIX)
+
+// One worker's share of a parallel scan.
+struct ScanTask
+{
+    const FrozenMap *map;
+    const EditPattern *pattern;
+    int begin;
+    int end;
+    int maxDistance;
+    TopK nearest;
+};
+
+// A thread of a SuggestionPool, which runs the pool's task of its index.
+struct PoolWorker
+{
+    SuggestionPool *pool;
+    pthread_t thread;
+    int index;
+};
+
+struct SuggestionPool
+{
+    pthread_mutex_t lock;
+    // Signalled when a scan is posted or the pool is deleted, and when the
+    // last worker finishes its task.
+    pthread_cond_t posted;
+    pthread_cond_t finished;
+    // Tasks of the current scan, one per thread; the caller runs the first.
+    ScanTask *tasks;
+    // Workers by task index; the first entry is unused.
+    PoolWorker *workers;
+    int threads;
+    // Counts posted scans, so a worker can tell a new one from a spurious
+    // wake-up.
+    unsigned generation;
+    // Workers still running their task of the current scan.
+    int pending;
+    int stopping;
+};
+
+struct SuggestionIndex
+{
+    const FrozenMap *map;
+    // Number of the posting list of each deletion string.
+    HashMap *deletes;
+    // Posting list i holds the entries postings[starts[i]] to
+    // postings[starts[i + 1] - 1], in the order of their words.
+    int *starts;
+    int *postings;
+};
+
+// A dictionary entry and its word, for visiting the entries in word order.
+struct SortedWord
+{
+    const char *word;
+    int entry;
+};
+
+/**
+ * Offers the words of the entries from begin to end - 1 to a selection.
+ */
+static void scanRange(const FrozenMap *map, const EditPattern *pattern, int begin,
+                      int end, int maxDistance, TopK *nearest)
+{
+    for (int i = begin; i < end; i++)
+    {
+        const char *key = frozenMapKey(map, i);
+        int bound = topKBound(nearest) < maxDistance ? topKBound(nearest) : maxDistance;
+        int distance = editPatternDistance(pattern, key, bound);
+        if (distance <= bound)
+        {
+            topKOffer(nearest, key, distance, 0);
+        }
+    }
+}
+
+/**
+ * Thread entry point running one ScanTask.
+ */
+static void *scanTaskRun(void *argument)
+{
+    ScanTask *task = argument;
+    scanRange(task->map, task->pattern, task->begin, task->end, task->maxDistance,
+              &task->nearest);
+    return NULL;
+}
+
+/**
+ * Compares a word with every word of the map, offering the nearest to a top-k
+ * selection as it goes. Once the selection is full, words further than its
+ * worst one are given up on after a few characters. Words longer than
+ * MAX_WORD_LENGTH get no suggestions.
+ * @param map Dictionary, which is not changed.
+ * @param word Misspelled word.
+ * @param maxDistance Largest distance of a suggestion.
+ * @param nearest Selection the words are offered to, with a weight of 0.
+ * @return Number of words in the selection.
+ */
+int suggestionScan(const FrozenMap *map, const char *word, int maxDistance, TopK *nearest)
+{
+    assert(map != 0);
+    assert(word != 0);
+
+    if (strlen(word) > MAX_WORD_LENGTH)
+    {
+        return nearest->size;
+    }
+    EditPattern pattern;
+    editPatternInit(&pattern, word);
+    scanRange(map, &pattern, 0, frozenMapSize(map), maxDistance, nearest);
+    return nearest->size;
+}
+
+/**
+ * Thread entry point of a pool worker: runs its task of every scan posted to
+ * the pool until the pool is deleted.
+ */
+static void *poolWorkerRun(void *argument)
+{
+    PoolWorker *worker = argument;
+    SuggestionPool *pool = worker->pool;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (!pool->stopping && pool->generation == seen)
+        {
+            pthread_cond_wait(&pool->posted, &pool->lock);
+        }
+        if (pool->stopping)
+        {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        scanTaskRun(&pool->tasks[worker->index]);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+        {
+            pthread_cond_signal(&pool->finished);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * Starts a pool of threads for parallel suggestion scans. The threads are
+ * started once and wait between scans, so a query costs no thread creation.
+ * @param threads Number of threads to scan with, including the caller's. If
+ * some can't be started, the pool scans with the ones that did.
+ * @return The allocated pool.
+ */
+SuggestionPool *suggestionPoolNew(int threads)
+{
+    SuggestionPool *pool = malloc(sizeof(SuggestionPool));
+    threads = threads < 1 ? 1 : threads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->posted, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    pool->tasks = malloc(sizeof(ScanTask) * threads);
+    pool->workers = malloc(sizeof(PoolWorker) * threads);
+    pool->generation = 0;
+    pool->pending = 0;
+    pool->stopping = 0;
+
+    // The calling thread runs the first task of each scan itself.
+    pool->threads = 1;
+    while (pool->threads < threads)
+    {
+        PoolWorker *worker = &pool->workers[pool->threads];
+        worker->pool = pool;
+        worker->index = pool->threads;
+        if (pthread_create(&worker->thread, NULL, poolWorkerRun, worker) != 0)
+        {
+            break;
+        }
+        pool->threads++;
+    }
+    return pool;
+}
+
+/**
+ * Stops the pool's threads and frees it. No scan may be in progress.
+ * @param pool
+ */
+void suggestionPoolDelete(SuggestionPool *pool)
+{
+    assert(pool != 0);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->posted);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 1; t < pool->threads; t++)
+    {
+        pthread_join(pool->workers[t].thread, NULL);
+    }
+    pthread_cond_destroy(&pool->finished);
+    pthread_cond_destroy(&pool->posted);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->tasks);
+    free(pool);
+}
+
+/**
+ * Returns the number of threads a pool scans with, including the caller's.
+ * @param pool
+ * @return Number of threads.
+ */
+int suggestionPoolThreads(const SuggestionPool *pool)
+{
+    assert(pool != 0);
+    return pool->threads;
+}
+
+/**
+ * Like suggestionScan, but splits the map's entries into one contiguous range
+ * per thread of the pool. Each thread keeps its own top-k selection, and they
+ * are merged into nearest once all threads are done, so the result is the
+ * same as with one thread. One scan at a time may use a pool.
+ * @param pool Threads to scan with.
+ * @param map Dictionary, which is not changed.
+ * @param word Misspelled word.
+ * @param maxDistance Largest distance of a suggestion.
+ * @param nearest Selection the words are offered to, with a weight of 0.
+ * @return Number of words in the selection.
+ */
+int suggestionPoolScan(SuggestionPool *pool, const FrozenMap *map, const char *word,
+                       int maxDistance, TopK *nearest)
+{
+    assert(pool != 0);
+    assert(map != 0);
+    assert(word != 0);
+
+    int size = frozenMapSize(map);
+    int threads = pool->threads;
+    if (threads == 1 || size < threads || strlen(word) > MAX_WORD_LENGTH)
+    {
+        return suggestionScan(map, word, maxDistance, nearest);
+    }
+
+    EditPattern pattern;
+    editPatternInit(&pattern, word);
+    for (int t = 0; t < threads; t++)
+    {
+        ScanTask *task = &pool->tasks[t];
+        task->map = map;
+        task->pattern = &pattern;
+        task->begin = (int)((long long)size * t / threads);
+        task->end = (int)((long long)size * (t + 1) / threads);
+        task->maxDistance = maxDistance;
+        topKInit(&task->nearest, nearest->capacity);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->pending = threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->posted);
+    pthread_mutex_unlock(&pool->lock);
+    scanTaskRun(&pool->tasks[0]);
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+    {
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int t = 0; t < threads; t++)
+    {
+        TopK *part = &pool->tasks[t].nearest;
+        for (int i = 0; i < part->size; i++)
+        {
+            topKOffer(nearest, part->entries[i].word, part->entries[i].distance,
+                      part->entries[i].weight);
+        }
+        topKRelease(part);
+    }
+    return nearest->size;
+}
+
+/**
+ * Like suggestionPoolScan, with a pool started for this one scan. Callers
+ * with many queries should keep a SuggestionPool instead.
+ * @param map Dictionary, which is not changed.
+ * @param word Misspelled word.
+ * @param maxDistance Largest distance of a suggestion.
+ * @param nearest Selection the words are offered to, with a weight of 0.
+ * @param threads Number of threads to scan with, including the caller's.
+ * @return Number of words in the selection.
+ */
+int suggestionScanParallel(const FrozenMap *map, const char *word, int maxDistance,
+                           TopK *nearest, int threads)
+{
+    assert(map != 0);
+    assert(word != 0);
+
+    int size = frozenMapSize(map);
+    if (threads > size)
+    {
+        threads = size;
+    }
+    if (threads <= 1 || strlen(word) > MAX_WORD_LENGTH)
+    {
+        return suggestionScan(map, word, maxDistance, nearest);
+    }
+    SuggestionPool *pool = suggestionPoolNew(threads);
+    int found = suggestionPoolScan(pool, map, word, maxDistance, nearest);
+    suggestionPoolDelete(pool);
+    return found;
+}
+
+/**
+ * Writes a string and every string left by deleting up to budget of its
+ * characters at or after from, so that each set of deleted positions is
+ * written once.
+ * @return Number of strings written so far.
+ */
+static int addDeletes(const char *string, int length, int from, int budget,
+                      char deletes[][SUGGESTION_INDEX_PREFIX], int *lengths, int count)
+{
+    memcpy(deletes[count], string, length);
+    lengths[count++] = length;
+    for (int i = from; budget > 0 && i < length; i++)
+    {
+        char shorter[SUGGESTION_INDEX_PREFIX];
+        memcpy(shorter, string, i);
+        memcpy(shorter + i, string + i + 1, length - i - 1);
+        count = addDeletes(shorter, length - 1, i, budget - 1, deletes, lengths, count);
+    }
+    return count;
+}
+
+/**
+ * Writes every string left by deleting up to SUGGESTION_INDEX_DISTANCE
+ * characters from the prefix of a word. A string may be written more than
+ * once when the word repeats a letter.
+ * @param word
+ * @param deletes Set to the strings, which are not terminated.
+ * @param lengths Set to the length of each string.
+ * @return Number of strings written.
+ */
+static int wordDeletes(const char *word, char deletes[][SUGGESTION_INDEX_PREFIX],
+                       int *lengths)
+{
+    int length = 0;
+    while (length < SUGGESTION_INDEX_PREFIX && word[length] != '\0')
+    {
+        length++;
+    }
+    return addDeletes(word, length, 0, SUGGESTION_INDEX_DISTANCE, deletes, lengths, 0);
+}
+
+/**
+ * Orders the entries of a dictionary by their words, for qsort.
+ */
+static int compareWords(const void *a, const void *b)
+{
+    return strcmp(((const SortedWord *)a)->word, ((const SortedWord *)b)->word);
+}
+
+/**
+ * Orders ints ascending, for qsort.
+ */
+static int compareInts(const void *a, const void *b)
+{
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Builds the deletion index of a dictionary. Every deletion string of every
+ * word is hashed once: the first pass numbers the strings and counts their
+ * words, and the second lays each string's words out in one array. Words are
+ * visited in alphabetical order, so that neighbours, which share most of
+ * their deletion strings, find them still in the cache; this halves the
+ * time of the first pass.
+ * @param map Dictionary, which must outlive the index and not change.
+ * @return The allocated index.
+ */
+SuggestionIndex *suggestionIndexNew(const FrozenMap *map)
+{
+    assert(map != 0);
+
+    int size = frozenMapSize(map);
+    SuggestionIndex *index = malloc(sizeof(SuggestionIndex));
+    index->map = map;
+    index->deletes = hashMapNewEngine(size, HASH_MAP_GROUP_PROBING);
+
+    // List of each deletion string of each word, the words' strings in
+    // word order, and per list its number of words and the last word added
+    // so that a word's repeated strings count once.
+    int pairCapacity = size * 8 + 1;
+    int *pairLists = malloc(sizeof(int) * pairCapacity);
+    int *wordEnds = malloc(sizeof(int) * (size + 1));
+    int listCapacity = size + 1;
+    int *counts = malloc(sizeof(int) * listCapacity);
+    int *lastWords = malloc(sizeof(int) * listCapacity);
+    SortedWord *order = malloc(sizeof(SortedWord) * (size + 1));
+    int pairs = 0;
+    int lists = 0;
+    char deletes[MAX_DELETES][SUGGESTION_INDEX_PREFIX];
+    int lengths[MAX_DELETES];
+
+    for (int w = 0; w < size; w++)
+    {
+        order[w].word = frozenMapKey(map, w);
+        order[w].entry = w;
+    }
+    qsort(order, size, sizeof(SortedWord), compareWords);
+    for (int w = 0; w < size; w++)
+    {
+        int count = wordDeletes(order[w].word, deletes, lengths);
+        for (int d = 0; d < count; d++)
+        {
+            int inserted;
+            int list = *hashMapGetOrInsertN(index->deletes, deletes[d], lengths[d], lists,
+                                            &inserted);
+            if (inserted)
+            {
+                if (lists == listCapacity)
+                {
+                    listCapacity *= 2;
+                    counts = realloc(counts, sizeof(int) * listCapacity);
+                    lastWords = realloc(lastWords, sizeof(int) * listCapacity);
+                }
+                counts[lists] = 0;
+                lastWords[lists] = -1;
+                lists++;
+            }
+            if (lastWords[list] == w)
+            {
+                continue;
+            }
+            lastWords[list] = w;
+            counts[list]++;
+            if (pairs == pairCapacity)
+            {
+                pairCapacity *= 2;
+                pairLists = realloc(pairLists, sizeof(int) * pairCapacity);
+            }
+            pairLists[pairs++] = list;
+        }
+        wordEnds[w] = pairs;
+    }
+
+    // Each list starts where the one before it ends; starts[i] then serves
+    // as the next free place of list i while filling.
+    index->starts = malloc(sizeof(int) * (lists + 1));
+    index->postings = malloc(sizeof(int) * (pairs > 0 ? pairs : 1));
+    int start = 0;
+    for (int i = 0; i < lists; i++)
+    {
+        index->starts[i] = start;
+        start += counts[i];
+    }
+    int pair = 0;
+    for (int w = 0; w < size; w++)
+    {
+        for (; pair < wordEnds[w]; pair++)
+        {
+            index->postings[index->starts[pairLists[pair]]++] = order[w].entry;
+        }
+    }
+    // Filling moved every start to the start of the next list.
+    for (int i = lists; i > 0; i--)
+    {
+        index->starts[i] = index->starts[i - 1];
+    }
+    index->starts[0] = 0;
+
+    free(order);
+    free(lastWords);
+    free(counts);
+    free(wordEnds);
+    free(pairLists);
+    return index;
+}
+
+/**
+ * Frees the index. The dictionary it was built from is not changed.
+ * @param index
+ */
+void suggestionIndexDelete(SuggestionIndex *index)
+{
+    assert(index != 0);
+    hashMapDelete(index->deletes);
+    free(index->postings);
+    free(index->starts);
+    free(index);
+}
+
+/**
+ * Gives the same suggestions as suggestionScan, from the words the index
+ * finds within SUGGESTION_INDEX_DISTANCE of the misspelled word. Those are
+ * the answer whenever maxDistance is within that distance or they fill the
+ * selection; otherwise the dictionary is scanned. A query only reads the
+ * index, so many can run at once, each with its own pool.
+ * @param index Index of the dictionary.
+ * @param pool Threads for a scan, or NULL to scan on the calling thread.
+ * @param word Misspelled word.
+ * @param maxDistance Largest distance of a suggestion.
+ * @param nearest Selection the words are offered to, with a weight of 0.
+ * @return Number of words in the selection.
+ */
+int suggestionIndexQuery(const SuggestionIndex *index, SuggestionPool *pool, const char *word,
+                         int maxDistance, TopK *nearest)
+{
+    assert(index != 0);
+    assert(word != 0);
+
+    if (strlen(word) > MAX_WORD_LENGTH)
+    {
+        return nearest->size;
+    }
+
+    // Words of every list a deletion string of the word leads to, each kept
+    // once.
+    char deletes[MAX_DELETES][SUGGESTION_INDEX_PREFIX];
+    int lengths[MAX_DELETES];
+    int count = wordDeletes(word, deletes, lengths);
+    int candidateCount = 0;
+    int candidateCapacity = 64;
+    int *candidates = malloc(sizeof(int) * candidateCapacity);
+    for (int d = 0; d < count; d++)
+    {
+        int *list = hashMapGetN(index->deletes, deletes[d], lengths[d]);
+        if (list == NULL)
+        {
+            continue;
+        }
+        int begin = index->starts[*list];
+        int end = index->starts[*list + 1];
+        if (candidateCount + end - begin > candidateCapacity)
+        {
+            while (candidateCount + end - begin > candidateCapacity)
+            {
+                candidateCapacity *= 2;
+            }
+            candidates = realloc(candidates, sizeof(int) * candidateCapacity);
+        }
+        memcpy(candidates + candidateCount, index->postings + begin,
+               sizeof(int) * (end - begin));
+        candidateCount += end - begin;
+    }
+    qsort(candidates, candidateCount, sizeof(int), compareInts);
+
+    EditPattern pattern;
+    editPatternInit(&pattern, word);
+    int limit = maxDistance < SUGGESTION_INDEX_DISTANCE ? maxDistance
+                                                        : SUGGESTION_INDEX_DISTANCE;
+    TopK found;
+    topKInit(&found, nearest->capacity);
+    for (int c = 0; c < candidateCount; c++)
+    {
+        if (c > 0 && candidates[c] == candidates[c - 1])
+        {
+            continue;
+        }
+        const char *key = frozenMapKey(index->map, candidates[c]);
+        int bound = topKBound(&found) < limit ? topKBound(&found) : limit;
+        int distance = editPatternDistance(&pattern, key, bound);
+        if (distance <= bound)
+        {
+            topKOffer(&found, key, distance, 0);
+        }
+    }
+    free(candidates);
+
+    // Words the index can't see are further than SUGGESTION_INDEX_DISTANCE,
+    // so they only matter if they are allowed and the selection has room.
+    if (maxDistance <= SUGGESTION_INDEX_DISTANCE ||
+        topKBound(&found) <= SUGGESTION_INDEX_DISTANCE)
+    {
+        for (int i = 0; i < found.size; i++)
+        {
+            topKOffer(nearest, found.entries[i].word, found.entries[i].distance,
+                      found.entries[i].weight);
+        }
+    }
+    else if (pool != NULL)
+    {
+        suggestionPoolScan(pool, index->map, word, maxDistance, nearest);
+    }
+    else
+    {
+        suggestionScan(index->map, word, maxDistance, nearest);
+    }
+    topKRelease(&found);
+    return nearest->size;
+}
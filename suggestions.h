@@ -0,0 +1,46 @@
+#ifndef SUGGESTIONS_H
+#define SUGGESTIONS_H
+
+/*
+ * Suggestions for a misspelled word from every word of a dictionary. A query
+ * keeps all of its state in its own TopK and on its stack and only reads the
+ * dictionary, so one dictionary can serve many queries at once. A
+ * SuggestionPool keeps threads for parallel scans across many queries.
+ *
+ * A SuggestionIndex replaces most scans with hash lookups, in the manner of
+ * SymSpell: every string left by deleting up to SUGGESTION_INDEX_DISTANCE
+ * characters from the first SUGGESTION_INDEX_PREFIX characters of a word is
+ * a key of a HashMap, whose value lists the words it came from. Two words
+ * within that distance of each other share such a string, so the deletions
+ * of a query find every candidate, which is then checked with its true
+ * distance.
+ */
+
+#include "frozenMap.h"
+#include "topK.h"
+
+// Largest distance the index finds words within; queries that need further
+// words scan the dictionary instead.
+#define SUGGESTION_INDEX_DISTANCE 2
+// Characters of each word the deletions are taken from.
+#define SUGGESTION_INDEX_PREFIX 7
+
+typedef struct SuggestionPool SuggestionPool;
+typedef struct SuggestionIndex SuggestionIndex;
+
+int suggestionScan(const FrozenMap* map, const char* word, int maxDistance, TopK* nearest);
+int suggestionScanParallel(const FrozenMap* map, const char* word, int maxDistance,
+                           TopK* nearest, int threads);
+
+SuggestionPool* suggestionPoolNew(int threads);
+void suggestionPoolDelete(SuggestionPool* pool);
+int suggestionPoolThreads(const SuggestionPool* pool);
+int suggestionPoolScan(SuggestionPool* pool, const FrozenMap* map, const char* word,
+                       int maxDistance, TopK* nearest);
+
+SuggestionIndex* suggestionIndexNew(const FrozenMap* map);
+void suggestionIndexDelete(SuggestionIndex* index);
+int suggestionIndexQuery(const SuggestionIndex* index, SuggestionPool* pool, const char* word,
+                         int maxDistance, TopK* nearest);
+
+#endif
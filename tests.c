@@ -5,10 +5,20 @@
 
 #include "CuTest.h"
 #include "hashMap.h"
+#include "frozenMap.h"
+#include "editDistance.h"
+#include "suggestions.h"
+#include "concurrentHashMap.h"
+#include "shardedHashMap.h"
+#include "documentChecker.h"
+#include "valueHashMap.h"
+#include "intHashMap.h"
+#include "wordScanner.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
 
 // --- Test Helpers ---
 
@@ -72,16 +82,38 @@ void histAdd(Histogram* hist, char* key)
  */
 void histFromTable(Histogram* hist, HashMap* map)
 {
+    HashMapIterator iterator;
+    const char* key;
+    int* value;
+
     histInit(hist);
+    hashMapIteratorInit(&iterator, map);
+    while (hashMapIteratorNext(&iterator, &key, &value))
+    {
+        histAdd(hist, (char*)key);
+    }
+}
+
+/**
+ * Counts the empty buckets (or slots) by looking at the table directly.
+ * @param map
+ * @return Number of empty buckets.
+ */
+int countEmptyBuckets(HashMap* map)
+{
+    int sum = 0;
     for (int i = 0; i < map->capacity; i++)
     {
-        HashLink* link = map->table[i];
-        while (link != NULL)
+        if (map->engine != HASH_MAP_CHAINED)
+        {
+            sum += map->slots[i].probe.hash == 0;
+        }
+        else if (map->table[i] == NULL)
         {
-            histAdd(hist, link->key);
-            link = link->next;
+            sum++;
         }
     }
+    return sum;
 }
 
 /**
@@ -118,11 +150,13 @@ void assertHistCounts(CuTest* test, Histogram* hist)
  * @param numLinks The number of key-value pairs to be added and removed.
  * @param numNotKeys The number of keys not in the table.
  * @param numBuckets The initial number of buckets (capacity) in the table.
+ * @param engine The table layout to test.
  */
-void testCase(CuTest* test, HashLink* links, const char** notKeys, int numLinks,
-              int numNotKeys, int numBuckets)
+void testCaseEngine(CuTest* test, HashLink* links, const char** notKeys,
+                    int numLinks, int numNotKeys, int numBuckets,
+                    HashMapEngine engine)
 {
-    HashMap* map = hashMapNew(numBuckets);
+    HashMap* map = hashMapNewEngine(numBuckets, engine);
     Histogram hist;
     
     // Add links
@@ -142,15 +176,7 @@ void testCase(CuTest* test, HashLink* links, const char** notKeys, int numLinks,
     CuAssertIntEquals(test, map->capacity, hashMapCapacity(map));
     
     // Check empty buckets
-    int sum = 0;
-    for (int i = 0; i < map->capacity; i++)
-    {
-        if (map->table[i] == NULL)
-        {
-            sum++;
-        }
-    }
-    CuAssertIntEquals(test, sum, hashMapEmptyBuckets(map));
+    CuAssertIntEquals(test, countEmptyBuckets(map), hashMapEmptyBuckets(map));
     
     // Check table load
     CuAssertIntEquals(test, (float)numLinks / map->capacity, hashMapTableLoad(map));
@@ -222,6 +248,16 @@ void testCase(CuTest* test, HashLink* links, const char** notKeys, int numLinks,
     hashMapDelete(map);
 }
 
+/**
+ * Runs testCaseEngine against a chained map.
+ */
+void testCase(CuTest* test, HashLink* links, const char** notKeys, int numLinks,
+              int numNotKeys, int numBuckets)
+{
+    testCaseEngine(test, links, notKeys, numLinks, numNotKeys, numBuckets,
+                   HASH_MAP_CHAINED);
+}
+
 /**
  * Tests hash map functions for a table with no more than one link
  * in each bucket and without hitting the table load threshold.
@@ -340,6 +376,1873 @@ void testValueUpdate(CuTest* test)
     hashMapDelete(map);
 }
 
+/**
+ * Tests a linear probing map with colliding keys while hitting the table load
+ * threshold.
+ * @param test
+ */
+void testLinearProbingOver(CuTest* test)
+{
+    printf("\n--- Testing linear probing over threshold ---\n");
+    HashLink links[] = {
+        { .key = "ab", .value = 0, .next = NULL },
+        { .key = "c", .value = 1, .next = NULL },
+        { .key = "ba", .value = 2, .next = NULL },
+        { .key = "f", .value = 3, .next = NULL },
+        { .key = "gh", .value = 4, .next = NULL }
+    };
+    const char* notKeys[] = { "b", "e", "hg" };
+    testCaseEngine(test, links, notKeys, 5, 3, 1, HASH_MAP_LINEAR_PROBING);
+}
+
+/**
+ * Tests that removing from a linear probing map keeps every other key in the
+ * same cluster reachable.
+ * @param test
+ */
+void testLinearProbingRemove(CuTest* test)
+{
+    int numKeys = 500;
+    char key[16];
+    HashMap* map = hashMapNewEngine(8, HASH_MAP_LINEAR_PROBING);
+
+    for (int i = 0; i < numKeys; i++)
+    {
+        sprintf(key, "k%d", i);
+        hashMapPut(map, key, i);
+    }
+    for (int i = 0; i < numKeys; i += 2)
+    {
+        sprintf(key, "k%d", i);
+        hashMapRemove(map, key);
+    }
+    CuAssertIntEquals(test, numKeys / 2, hashMapSize(map));
+    for (int i = 0; i < numKeys; i++)
+    {
+        sprintf(key, "k%d", i);
+        int* value = hashMapGet(map, key);
+        if (i % 2 == 0)
+        {
+            CuAssertPtrEquals(test, NULL, value);
+        }
+        else
+        {
+            CuAssertPtrNotNull(test, value);
+            CuAssertIntEquals(test, i, *value);
+        }
+    }
+    CuAssertIntEquals(test, countEmptyBuckets(map), hashMapEmptyBuckets(map));
+    hashMapDelete(map);
+}
+
+/**
+ * Tests a group probing map with colliding keys while hitting the table load
+ * threshold.
+ * @param test
+ */
+void testGroupProbingOver(CuTest* test)
+{
+    printf("\n--- Testing group probing over threshold ---\n");
+    HashLink links[] = {
+        { .key = "ab", .value = 0, .next = NULL },
+        { .key = "c", .value = 1, .next = NULL },
+        { .key = "ba", .value = 2, .next = NULL },
+        { .key = "f", .value = 3, .next = NULL },
+        { .key = "gh", .value = 4, .next = NULL }
+    };
+    const char* notKeys[] = { "b", "e", "hg" };
+    testCaseEngine(test, links, notKeys, 5, 3, 1, HASH_MAP_GROUP_PROBING);
+}
+
+/**
+ * Tests that a group probing map stays consistent through repeated removal and
+ * reinsertion, which fills it with deleted tags.
+ * @param test
+ */
+void testGroupProbingChurn(CuTest* test)
+{
+    int numKeys = 300;
+    char key[16];
+    HashMap* map = hashMapNewEngine(16, HASH_MAP_GROUP_PROBING);
+
+    for (int round = 0; round < 5; round++)
+    {
+        for (int i = 0; i < numKeys; i++)
+        {
+            sprintf(key, "k%d", i);
+            hashMapPut(map, key, i + round);
+        }
+        for (int i = 0; i < numKeys; i += 3)
+        {
+            sprintf(key, "k%d", i);
+            hashMapRemove(map, key);
+        }
+    }
+    CuAssertIntEquals(test, numKeys - numKeys / 3, hashMapSize(map));
+    for (int i = 0; i < numKeys; i++)
+    {
+        sprintf(key, "k%d", i);
+        int* value = hashMapGet(map, key);
+        if (i % 3 == 0)
+        {
+            CuAssertPtrEquals(test, NULL, value);
+        }
+        else
+        {
+            CuAssertPtrNotNull(test, value);
+            CuAssertIntEquals(test, i + 4, *value);
+        }
+    }
+    hashMapDelete(map);
+}
+
+/**
+ * Tests known answers of the hash functions and that seeds change them.
+ * @param test
+ */
+void testHashFunctions(CuTest* test)
+{
+    CuAssertTrue(test, hashFunctionFnv1a("", 0, 0) == 0xCBF29CE484222325ull);
+    CuAssertTrue(test, hashFunctionFnv1a("a", 1, 0) == 0xAF63DC4C8601EC8Cull);
+    CuAssertTrue(test, hashFunctionLegacy1("ab", 2, 0) == 'a' + 'b');
+    CuAssertTrue(test, hashFunctionLegacy1("ab", 2, 0) == hashFunctionLegacy1("ba", 2, 0));
+    CuAssertTrue(test, hashFunctionLegacy2("ab", 2, 0) != hashFunctionLegacy2("ba", 2, 0));
+    // Test vectors of the reference wyhash final4, which seeds each with
+    // its index. They cover the empty, 1-3, 4-16, 17-48 and over 48 byte
+    // paths.
+    CuAssertTrue(test, hashFunctionWy("", 0, 0) == 0x93228A4DE0EEC5A2ull);
+    CuAssertTrue(test, hashFunctionWy("a", 1, 1) == 0xC5BAC3DB178713C4ull);
+    CuAssertTrue(test, hashFunctionWy("abc", 3, 2) == 0xA97F2F7B1D9B3314ull);
+    CuAssertTrue(test, hashFunctionWy("message digest", 14, 3) == 0x786D1F1DF3801DF4ull);
+    CuAssertTrue(test, hashFunctionWy("abcdefghijklmnopqrstuvwxyz", 26, 4) ==
+                       0xDCA5A8138AD37C87ull);
+    CuAssertTrue(test,
+                 hashFunctionWy("12345678901234567890123456789012345678901234567890"
+                                "123456789012345678901234567890",
+                                80, 6) == 0x6CC5EAB49A92D617ull);
+    CuAssertTrue(test, hashFunctionWy("ab", 2, 0) != hashFunctionWy("ba", 2, 0));
+    CuAssertTrue(test, hashFunctionWy("ab", 2, 0) != hashFunctionWy("ab", 2, 1));
+    CuAssertTrue(test, hashFunctionWy("abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnop", 52, 7) ==
+                       hashFunctionWy("abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnop", 52, 7));
+}
+
+/**
+ * Tests that switching hash functions on a filled map keeps every key
+ * reachable, for every engine.
+ * @param test
+ */
+void testSetHashFunction(CuTest* test)
+{
+    HashFunction functions[] = { hashFunctionLegacy1, hashFunctionLegacy2,
+                                 hashFunctionFnv1a, hashFunctionWy };
+    HashMapEngine engines[] = { HASH_MAP_CHAINED, HASH_MAP_LINEAR_PROBING,
+                                HASH_MAP_GROUP_PROBING };
+    char key[16];
+
+    for (int e = 0; e < 3; e++)
+    {
+        HashMap* map = hashMapNewEngine(4, engines[e]);
+        for (int i = 0; i < 200; i++)
+        {
+            sprintf(key, "w%d", i);
+            hashMapPut(map, key, i);
+        }
+        for (int f = 0; f < 4; f++)
+        {
+            hashMapSetHashFunction(map, functions[f], 0x1234 + f);
+            CuAssertIntEquals(test, 200, hashMapSize(map));
+            for (int i = 0; i < 200; i++)
+            {
+                sprintf(key, "w%d", i);
+                int* value = hashMapGet(map, key);
+                CuAssertPtrNotNull(test, value);
+                CuAssertIntEquals(test, i, *value);
+            }
+        }
+        hashMapDelete(map);
+    }
+}
+
+static int hashCalls = 0;
+
+/**
+ * Hash function that counts how many times it is called.
+ */
+uint64_t countingHash(const void* key, size_t length, uint64_t seed)
+{
+    hashCalls++;
+    return hashFunctionFnv1a(key, length, seed);
+}
+
+/**
+ * Tests that growing a chained map reuses the cached hashes instead of hashing
+ * every key again on each resize.
+ * @param test
+ */
+void testResizeUsesCachedHash(CuTest* test)
+{
+    int numKeys = 1000;
+    char key[16];
+    HashMap* map = hashMapNew(1);
+    hashMapSetHashFunction(map, countingHash, 0);
+
+    hashCalls = 0;
+    for (int i = 0; i < numKeys; i++)
+    {
+        sprintf(key, "w%d", i);
+        hashMapPut(map, key, i);
+    }
+    CuAssertTrue(test, map->capacity >= numKeys);
+    // Each put hashes its key once.
+    CuAssertIntEquals(test, numKeys, hashCalls);
+    for (int i = 0; i < numKeys; i++)
+    {
+        sprintf(key, "w%d", i);
+        CuAssertIntEquals(test, 1, hashMapContainsKey(map, key));
+    }
+    hashMapDelete(map);
+}
+
+/**
+ * Tests that an incrementally resizing map answers correctly while keys are
+ * spread over the old and the new table.
+ * @param test
+ */
+void testIncrementalResize(CuTest* test)
+{
+    int numKeys = 1000;
+    int sawMigration = 0;
+    char key[16];
+    HashMap* map = hashMapNew(4);
+    hashMapSetIncrementalResize(map, 2);
+
+    for (int i = 0; i < numKeys; i++)
+    {
+        sprintf(key, "w%d", i);
+        hashMapPut(map, key, i);
+        if (map->oldTable != NULL)
+        {
+            sawMigration = 1;
+            // Every key inserted so far must be visible mid-migration.
+            Histogram hist;
+            histFromTable(&hist, map);
+            CuAssertIntEquals(test, i + 1, hist.size);
+            histCleanUp(&hist);
+        }
+    }
+    CuAssertTrue(test, sawMigration);
+    for (int i = 0; i < numKeys; i += 2)
+    {
+        sprintf(key, "w%d", i);
+        hashMapRemove(map, key);
+    }
+    CuAssertIntEquals(test, numKeys / 2, hashMapSize(map));
+    for (int i = 0; i < numKeys; i++)
+    {
+        sprintf(key, "w%d", i);
+        CuAssertIntEquals(test, i % 2, hashMapContainsKey(map, key));
+    }
+    hashMapFinishResize(map);
+    CuAssertPtrEquals(test, NULL, map->oldTable);
+    CuAssertIntEquals(test, countEmptyBuckets(map), hashMapEmptyBuckets(map));
+    hashMapDelete(map);
+}
+
+/**
+ * Tests that the pool and arena recycle freed memory.
+ * @param test
+ */
+void testMemoryPool(CuTest* test)
+{
+    Pool pool;
+    Arena arena;
+
+    poolInit(&pool, 24, 4);
+    void* objects[10];
+    for (int i = 0; i < 10; i++)
+    {
+        objects[i] = poolAlloc(&pool);
+        memset(objects[i], i, 24);
+    }
+    poolFree(&pool, objects[3]);
+    CuAssertPtrEquals(test, objects[3], poolAlloc(&pool));
+    poolRelease(&pool);
+
+    arenaInit(&arena, 256);
+    char* small = arenaAlloc(&arena, 5);
+    char* other = arenaAlloc(&arena, 13);
+    CuAssertTrue(test, ((size_t)small & 7) == 0 && ((size_t)other & 7) == 0);
+    arenaFree(&arena, small, 5);
+    CuAssertPtrEquals(test, small, arenaAlloc(&arena, 7));
+    char* large = arenaAlloc(&arena, 1000);
+    memset(large, 1, 1000);
+    arenaRelease(&arena);
+}
+
+/**
+ * Returns the length of a list whose nodes start with a next pointer, like
+ * the blocks and large chunks of an arena.
+ */
+static int memoryListLength(void* node)
+{
+    int length = 0;
+    for (; node != NULL; node = *(void**)node)
+    {
+        length++;
+    }
+    return length;
+}
+
+/**
+ * Tests that churning keys over 256 bytes through a map of constant size
+ * keeps the key arena from growing.
+ * @param test
+ */
+void testArenaChurn(CuTest* test)
+{
+    HashMapEngine engines[] = {HASH_MAP_CHAINED, HASH_MAP_GROUP_PROBING};
+    char key[400];
+
+    for (int e = 0; e < 2; e++)
+    {
+        HashMap* map = hashMapNewEngine(16, engines[e]);
+        int blocks = -1;
+        memset(key, 'k', sizeof(key) - 1);
+        key[sizeof(key) - 1] = '\0';
+        for (int i = 0; i < 5000; i++)
+        {
+            sprintf(key, "%d", i);
+            key[strlen(key)] = 'k';
+            // Lengths vary so that freed chunks don't just fit the next key.
+            hashMapPutN(map, key, 300 + i % 90, i);
+            if (i >= 10)
+            {
+                sprintf(key, "%d", i - 10);
+                key[strlen(key)] = 'k';
+                hashMapRemoveN(map, key, 300 + (i - 10) % 90);
+            }
+            if (i == 10)
+            {
+                blocks = memoryListLength(map->keyArena.blocks);
+            }
+        }
+        CuAssertIntEquals(test, 10, hashMapSize(map));
+        CuAssertIntEquals(test, 10, memoryListLength(map->keyArena.largeChunks));
+        CuAssertIntEquals(test, blocks, memoryListLength(map->keyArena.blocks));
+        hashMapDelete(map);
+    }
+}
+
+/**
+ * Tests counting words with hashMapGetOrInsert on every engine.
+ * @param test
+ */
+void testGetOrInsert(CuTest* test)
+{
+    const char* words[] = { "the", "cat", "the", "hat", "cat", "the" };
+    HashMapEngine engines[] = { HASH_MAP_CHAINED, HASH_MAP_LINEAR_PROBING,
+                                HASH_MAP_GROUP_PROBING };
+
+    for (int e = 0; e < 3; e++)
+    {
+        HashMap* map = hashMapNewEngine(1, engines[e]);
+        int insertedCount = 0;
+        for (int i = 0; i < 6; i++)
+        {
+            int inserted;
+            int* count = hashMapGetOrInsert(map, words[i], 0, &inserted);
+            (*count)++;
+            insertedCount += inserted;
+        }
+        CuAssertIntEquals(test, 3, insertedCount);
+        CuAssertIntEquals(test, 3, hashMapSize(map));
+        CuAssertIntEquals(test, 3, *hashMapGet(map, "the"));
+        CuAssertIntEquals(test, 2, *hashMapGet(map, "cat"));
+        CuAssertIntEquals(test, 1, *hashMapGet(map, "hat"));
+        CuAssertIntEquals(test, 3, *hashMapGetOrInsert(map, "the", 0, NULL));
+        hashMapDelete(map);
+    }
+}
+
+/**
+ * Tests that a batch put matches one put per key, including duplicate keys,
+ * and grows the table only once.
+ * @param test
+ */
+void testPutBatch(CuTest* test)
+{
+    int numKeys = 2000;
+    char* storage = malloc(numKeys * 8);
+    const char** keys = malloc(sizeof(char*) * numKeys);
+    HashMapEngine engines[] = { HASH_MAP_CHAINED, HASH_MAP_LINEAR_PROBING,
+                                HASH_MAP_GROUP_PROBING };
+
+    for (int i = 0; i < numKeys; i++)
+    {
+        // Every key appears twice.
+        sprintf(storage + i * 8, "b%d", i / 2);
+        keys[i] = storage + i * 8;
+    }
+    for (int e = 0; e < 3; e++)
+    {
+        HashMap* map = hashMapNewEngine(1, engines[e]);
+        hashMapPut(map, "b0", 5);
+        hashMapPut(map, "extra", 5);
+        hashMapPutBatch(map, keys, numKeys, 7);
+        CuAssertIntEquals(test, numKeys / 2 + 1, hashMapSize(map));
+        for (int i = 0; i < numKeys; i++)
+        {
+            int* value = hashMapGet(map, keys[i]);
+            CuAssertPtrNotNull(test, value);
+            CuAssertIntEquals(test, 7, *value);
+        }
+        CuAssertIntEquals(test, 5, *hashMapGet(map, "extra"));
+        hashMapDelete(map);
+    }
+    free(keys);
+    free(storage);
+}
+
+/**
+ * Tests that batched lookups agree with hashMapGet on every engine, including
+ * a chained map in the middle of an incremental resize and a snapshot.
+ * @param test
+ */
+void testGetBatch(CuTest* test)
+{
+    int numQueries = 1300;
+    char (*queries)[16] = malloc(sizeof(*queries) * numQueries);
+    const char** keys = malloc(sizeof(char*) * numQueries);
+    int** values = malloc(sizeof(int*) * numQueries);
+    HashMap* maps[5];
+    char key[16];
+
+    // Keys g0 to g699 are in the maps; some queries repeat and some miss.
+    for (int i = 0; i < numQueries; i++)
+    {
+        sprintf(queries[i], "g%d", i * 7 % 1000);
+        keys[i] = queries[i];
+    }
+    maps[0] = hashMapNewEngine(4, HASH_MAP_CHAINED);
+    maps[1] = hashMapNewEngine(4, HASH_MAP_LINEAR_PROBING);
+    maps[2] = hashMapNewEngine(4, HASH_MAP_GROUP_PROBING);
+    maps[3] = hashMapNew(4);
+    hashMapSetIncrementalResize(maps[3], 1);
+    for (int m = 0; m < 4; m++)
+    {
+        for (int i = 0; i < 700; i++)
+        {
+            sprintf(key, "g%d", i);
+            hashMapPut(maps[m], key, i);
+        }
+    }
+    CuAssertTrue(test, maps[3]->oldTable != NULL);
+    CuAssertIntEquals(test, 0, hashMapSave(maps[2], "test.snapshot"));
+    maps[4] = hashMapLoadSnapshot("test.snapshot");
+    CuAssertPtrNotNull(test, maps[4]);
+
+    for (int m = 0; m < 5; m++)
+    {
+        int found = 0;
+        int batchFound = hashMapGetBatch(maps[m], keys, numQueries, values);
+        for (int i = 0; i < numQueries; i++)
+        {
+            CuAssertTrue(test, values[i] == hashMapGet(maps[m], keys[i]));
+            found += values[i] != NULL;
+        }
+        CuAssertIntEquals(test, found, batchFound);
+        CuAssertTrue(test, found > 700 && found < numQueries);
+        CuAssertIntEquals(test, 0, hashMapGetBatch(maps[m], keys, 0, values));
+        hashMapDelete(maps[m]);
+    }
+    remove("test.snapshot");
+    free(values);
+    free(keys);
+    free(queries);
+}
+
+// Lookups made by each thread sharing a map with stats.
+#define STATS_LOOKUPS 20000
+
+static void* statsLookup(void* argument)
+{
+    const HashMap* map = argument;
+    char key[16];
+    for (int i = 0; i < STATS_LOOKUPS; i++)
+    {
+        sprintf(key, "s%d", i % 200);
+        hashMapContainsKey(map, key);
+    }
+    return NULL;
+}
+
+/**
+ * Tests the stats kept by each engine, chain length histograms and the JSON
+ * dump.
+ * @param test
+ */
+void testStats(CuTest* test)
+{
+    HashMapEngine engines[] = {HASH_MAP_CHAINED, HASH_MAP_LINEAR_PROBING, HASH_MAP_GROUP_PROBING};
+    int histogram[8];
+    char key[16];
+    char json[1024];
+    double mean;
+
+    for (int e = 0; e < 3; e++)
+    {
+        HashMap* map = hashMapNewEngine(4, engines[e]);
+        CuAssertPtrEquals(test, NULL, (void*)hashMapStats(map));
+        hashMapSetStats(map, 1);
+        for (int i = 0; i < 200; i++)
+        {
+            sprintf(key, "s%d", i);
+            hashMapPut(map, key, i);
+        }
+        hashMapPut(map, "s0", 0);
+        for (int i = 0; i < 200; i++)
+        {
+            sprintf(key, "s%d", i);
+            CuAssertPtrNotNull(test, hashMapGet(map, key));
+        }
+        CuAssertIntEquals(test, 0, hashMapContainsKey(map, "missing"));
+        for (int i = 0; i < 10; i++)
+        {
+            sprintf(key, "s%d", i);
+            hashMapRemove(map, key);
+        }
+
+        const HashMapStats* stats = hashMapStats(map);
+        CuAssertTrue(test, stats->puts == 201 && stats->inserts == 200);
+        CuAssertTrue(test, stats->lookups == 201 && stats->removes == 10);
+        CuAssertTrue(test, stats->compares >= 211 && stats->probes >= stats->compares);
+        CuAssertTrue(test, stats->maxProbes >= 1 && stats->resizes > 0);
+
+        int longest = hashMapChainLengths(map, histogram, 8, &mean);
+        int total = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            total += histogram[i];
+        }
+        CuAssertIntEquals(test, engines[e] == HASH_MAP_CHAINED ? map->capacity : 190, total);
+        CuAssertTrue(test, longest >= 1 && mean >= 1 && mean <= longest);
+
+        FILE* file = tmpfile();
+        hashMapPrintStatsJson(map, file);
+        rewind(file);
+        CuAssertPtrNotNull(test, fgets(json, sizeof(json), file));
+        fclose(file);
+        CuAssertPtrNotNull(test, strstr(json, "\"size\": 190"));
+        CuAssertPtrNotNull(test, strstr(json, "\"lookups\": 201"));
+
+        hashMapResetStats(map);
+        CuAssertTrue(test, stats->lookups == 0 && stats->probes == 0);
+
+        // Threads may share a map with stats for lookups without losing counts.
+        pthread_t threads[4];
+        for (int t = 0; t < 4; t++)
+        {
+            CuAssertIntEquals(test, 0, pthread_create(&threads[t], NULL, statsLookup, map));
+        }
+        for (int t = 0; t < 4; t++)
+        {
+            pthread_join(threads[t], NULL);
+        }
+        CuAssertTrue(test, stats->lookups == 4 * STATS_LOOKUPS);
+        CuAssertTrue(test, stats->compares == 4 * STATS_LOOKUPS / 200 * 190);
+        hashMapResetStats(map);
+        hashMapSetStats(map, 0);
+        file = tmpfile();
+        hashMapPrintStatsJson(map, file);
+        rewind(file);
+        CuAssertPtrNotNull(test, fgets(json, sizeof(json), file));
+        fclose(file);
+        CuAssertPtrNotNull(test, strstr(json, "\"stats\": null}"));
+        hashMapDelete(map);
+    }
+
+    // Summing characters gives much longer chains than a real hash function.
+    HashMap* weak = hashMapNew(4);
+    HashMap* strong = hashMapNew(4);
+    hashMapSetHashFunction(weak, hashFunctionLegacy1, 0);
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "s%d", i);
+        hashMapPut(weak, key, i);
+        hashMapPut(strong, key, i);
+    }
+    CuAssertTrue(test, hashMapChainLengths(weak, NULL, 0, NULL) >
+                           2 * hashMapChainLengths(strong, NULL, 0, NULL));
+
+    // Rehashing for a new hash function is not a resize.
+    hashMapSetStats(strong, 1);
+    hashMapSetHashFunction(strong, hashFunctionLegacy1, 0);
+    CuAssertIntEquals(test, 0, hashMapStats(strong)->resizes);
+    CuAssertIntEquals(test, 999, *hashMapGet(strong, "s999"));
+    hashMapDelete(weak);
+    hashMapDelete(strong);
+}
+
+/**
+ * Tests presizing, growth factors and shrinking after removals on each
+ * engine.
+ * @param test
+ */
+void testLoadFactors(CuTest* test)
+{
+    HashMapEngine engines[] = {HASH_MAP_CHAINED, HASH_MAP_LINEAR_PROBING, HASH_MAP_GROUP_PROBING};
+    char key[16];
+
+    for (int e = 0; e < 3; e++)
+    {
+        HashMap* map = hashMapNewEngine(100, engines[e]);
+        CuAssertIntEquals(test, 128, hashMapCapacity(map));
+
+        // A reserved table takes all its keys without resizing.
+        hashMapSetStats(map, 1);
+        hashMapReserve(map, 1000);
+        int reserved = hashMapCapacity(map);
+        CuAssertTrue(test, reserved >= 1000 * map->maxLoad / 2);
+        hashMapResetStats(map);
+        for (int i = 0; i < 1000; i++)
+        {
+            sprintf(key, "r%d", i);
+            hashMapPut(map, key, i);
+        }
+        CuAssertIntEquals(test, 0, hashMapStats(map)->resizes);
+        CuAssertIntEquals(test, reserved, hashMapCapacity(map));
+
+        // Removing most keys shrinks the table once minLoad is set, and the
+        // rest stay reachable.
+        hashMapSetLoadFactors(map, 0.5, 0.1);
+        int grown = hashMapCapacity(map);
+        CuAssertTrue(test, map->size <= grown * 0.5);
+        for (int i = 0; i < 990; i++)
+        {
+            sprintf(key, "r%d", i);
+            hashMapRemove(map, key);
+        }
+        CuAssertIntEquals(test, 10, hashMapSize(map));
+        CuAssertTrue(test, hashMapCapacity(map) < grown);
+        CuAssertTrue(test, hashMapTableLoad(map) >= 0.1 && hashMapTableLoad(map) <= 0.5);
+        for (int i = 990; i < 1000; i++)
+        {
+            sprintf(key, "r%d", i);
+            CuAssertIntEquals(test, i, *hashMapGet(map, key));
+        }
+
+        // A larger growth factor skips sizes.
+        hashMapSetLoadFactors(map, 0.5, 0);
+        hashMapSetGrowthFactor(map, 4);
+        hashMapShrinkToFit(map);
+        int fit = hashMapCapacity(map);
+        CuAssertTrue(test, fit >= 20 && fit < 80);
+        for (int i = 0; i < 40; i++)
+        {
+            sprintf(key, "g%d", i);
+            hashMapPut(map, key, i);
+        }
+        CuAssertTrue(test, hashMapCapacity(map) >= fit * 4);
+        CuAssertIntEquals(test, 50, hashMapSize(map));
+        hashMapDelete(map);
+    }
+}
+
+// Values of testValueHashMap, owning a heap allocated name.
+typedef struct TestRecord
+{
+    double score;
+    char* name;
+    int id;
+} TestRecord;
+
+static int destroyedRecords;
+
+static void destroyTestRecord(void* value)
+{
+    free(((TestRecord*)value)->name);
+    destroyedRecords++;
+}
+
+/**
+ * Tests a map with struct values stored inline, and that the destructor runs
+ * once for every value replaced, removed or deleted with the map.
+ * @param test
+ */
+void testValueHashMap(CuTest* test)
+{
+    ValueHashMap* map = valueHashMapNew(4, sizeof(TestRecord), destroyTestRecord);
+    char key[16];
+    destroyedRecords = 0;
+
+    for (int i = 0; i < 500; i++)
+    {
+        TestRecord record = {i / 2.0, malloc(16), i};
+        sprintf(key, "v%d", i);
+        strcpy(record.name, key);
+        TestRecord* stored = valueHashMapPut(map, key, &record);
+        CuAssertIntEquals(test, i, stored->id);
+    }
+    CuAssertIntEquals(test, 500, valueHashMapSize(map));
+    CuAssertTrue(test, valueHashMapCapacity(map) * 0.75 >= 500);
+    for (int i = 0; i < 500; i++)
+    {
+        sprintf(key, "v%d", i);
+        TestRecord* record = valueHashMapGet(map, key);
+        CuAssertPtrNotNull(test, record);
+        CuAssertIntEquals(test, i, record->id);
+        CuAssertDblEquals(test, i / 2.0, record->score, 0);
+        CuAssertStrEquals(test, key, record->name);
+    }
+    CuAssertPtrEquals(test, NULL, valueHashMapGet(map, "v500"));
+
+    // Replacing a value destroys the old one; updating in place does not.
+    TestRecord replacement = {-1, malloc(16), -1};
+    strcpy(replacement.name, "new");
+    valueHashMapPut(map, "v7", &replacement);
+    CuAssertIntEquals(test, 1, destroyedRecords);
+    int inserted;
+    TestRecord* record = valueHashMapGetOrInsert(map, "v7", &inserted);
+    CuAssertIntEquals(test, 0, inserted);
+    CuAssertStrEquals(test, "new", record->name);
+    record->id = 7;
+    CuAssertIntEquals(test, 7, ((TestRecord*)valueHashMapGet(map, "v7"))->id);
+    record = valueHashMapGetOrInsert(map, "fresh", &inserted);
+    CuAssertIntEquals(test, 1, inserted);
+    CuAssertTrue(test, record->name == NULL && record->id == 0);
+    CuAssertIntEquals(test, 1, valueHashMapRemove(map, "fresh"));
+    CuAssertIntEquals(test, 2, destroyedRecords);
+
+    // Removals shift clusters back; every other key stays reachable.
+    for (int i = 0; i < 500; i += 2)
+    {
+        sprintf(key, "v%d", i);
+        CuAssertIntEquals(test, 1, valueHashMapRemove(map, key));
+    }
+    CuAssertIntEquals(test, 0, valueHashMapRemove(map, "v0"));
+    CuAssertIntEquals(test, 252, destroyedRecords);
+    CuAssertIntEquals(test, 250, valueHashMapSize(map));
+    for (int i = 0; i < 500; i++)
+    {
+        sprintf(key, "v%d", i);
+        CuAssertIntEquals(test, i % 2, valueHashMapContainsKey(map, key));
+    }
+
+    ValueHashMapIterator iterator;
+    const char* iteratedKey;
+    void* value;
+    int count = 0;
+    valueHashMapIteratorInit(&iterator, map);
+    while (valueHashMapIteratorNext(&iterator, &iteratedKey, &value))
+    {
+        CuAssertStrEquals(test, iteratedKey, ((TestRecord*)value)->name[0] == 'n'
+                                                 ? "v7"
+                                                 : ((TestRecord*)value)->name);
+        count++;
+    }
+    CuAssertIntEquals(test, 250, count);
+
+    // The table honours its load factors, shrinking once removals leave it
+    // below the minimum load.
+    valueHashMapSetLoadFactors(map, 0.5, 0.2);
+    CuAssertIntEquals(test, 1024, valueHashMapCapacity(map));
+    for (int i = 1; i < 400; i += 2)
+    {
+        sprintf(key, "v%d", i);
+        CuAssertIntEquals(test, 1, valueHashMapRemove(map, key));
+    }
+    CuAssertIntEquals(test, 50, valueHashMapSize(map));
+    CuAssertTrue(test, valueHashMapCapacity(map) < 1024);
+    valueHashMapShrinkToFit(map);
+    CuAssertIntEquals(test, 128, valueHashMapCapacity(map));
+    valueHashMapReserve(map, 300);
+    CuAssertIntEquals(test, 1024, valueHashMapCapacity(map));
+    for (int i = 401; i < 500; i += 2)
+    {
+        sprintf(key, "v%d", i);
+        CuAssertIntEquals(test, i, ((TestRecord*)valueHashMapGet(map, key))->id);
+    }
+
+    valueHashMapDelete(map);
+    CuAssertIntEquals(test, 502, destroyedRecords);
+
+    // Values of any size start aligned for any type.
+    struct AlignmentProbe
+    {
+        char offset;
+        ValueAlignment aligned;
+    };
+    map = valueHashMapNew(4, 3, NULL);
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "a%d", i);
+        void* stored = valueHashMapPut(map, key, "ab");
+        CuAssertIntEquals(test, 0, (int)((uintptr_t)stored % offsetof(struct AlignmentProbe, aligned)));
+    }
+    valueHashMapDelete(map);
+}
+
+/**
+ * Tests keys of explicit length with zero bytes on each engine and through a
+ * snapshot, and that they coexist with string keys.
+ * @param test
+ */
+void testBinaryKeys(CuTest* test)
+{
+    HashMap* maps[4];
+    const char keys[][3] = {{'a', 0, 'b'}, {'a', 0, 'c'}, {0, 0, 0}, {'a', 0, 0}};
+    size_t lengths[] = {3, 3, 3, 1};
+
+    maps[0] = hashMapNewEngine(4, HASH_MAP_CHAINED);
+    maps[1] = hashMapNewEngine(4, HASH_MAP_LINEAR_PROBING);
+    maps[2] = hashMapNewEngine(4, HASH_MAP_GROUP_PROBING);
+    for (int m = 0; m < 3; m++)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            hashMapPutN(maps[m], keys[i], lengths[i], i);
+        }
+        hashMapPut(maps[m], "ab", 4);
+        CuAssertIntEquals(test, 5, hashMapSize(maps[m]));
+        // "a" is the key of length one, not a prefix of the longer keys.
+        CuAssertIntEquals(test, 3, *hashMapGet(maps[m], "a"));
+        CuAssertIntEquals(test, 4, *hashMapGetN(maps[m], "abc", 2));
+        CuAssertPtrEquals(test, NULL, hashMapGetN(maps[m], keys[0], 2));
+        CuAssertPtrEquals(test, NULL, hashMapGetN(maps[m], "", 0));
+
+        HashMapIterator iterator;
+        const char* key;
+        int* value;
+        hashMapIteratorInit(&iterator, maps[m]);
+        while (hashMapIteratorNext(&iterator, &key, &value))
+        {
+            size_t length = *value < 4 ? lengths[*value] : 2;
+            CuAssertIntEquals(test, (int)length, iterator.keyLength);
+            CuAssertTrue(test, memcmp(key, *value < 4 ? keys[*value] : "ab", length) == 0);
+        }
+    }
+    CuAssertIntEquals(test, 0, hashMapSave(maps[1], "test.snapshot"));
+    maps[3] = hashMapLoadSnapshot("test.snapshot");
+    CuAssertPtrNotNull(test, maps[3]);
+    for (int m = 0; m < 4; m++)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            CuAssertIntEquals(test, 1, hashMapContainsKeyN(maps[m], keys[i], lengths[i]));
+            CuAssertIntEquals(test, i, *hashMapGetN(maps[m], keys[i], lengths[i]));
+        }
+        // A key hashed once can be looked up with its hash.
+        uint64_t hash = hashMapHash(maps[m], keys[2], 3);
+        CuAssertIntEquals(test, 2, *hashMapGetHashed(maps[m], keys[2], 3, hash));
+        CuAssertIntEquals(test, 1, hashMapContainsKeyHashed(maps[m], keys[2], 3, hash));
+        if (m < 3)
+        {
+            int inserted;
+            CuAssertIntEquals(test, 1, *hashMapGetOrInsertN(maps[m], keys[1], 3, 9, &inserted));
+            CuAssertIntEquals(test, 0, inserted);
+            hashMapRemoveN(maps[m], keys[0], 3);
+            CuAssertIntEquals(test, 0, hashMapContainsKeyN(maps[m], keys[0], 3));
+            CuAssertIntEquals(test, 1, hashMapContainsKeyN(maps[m], keys[1], 3));
+        }
+        hashMapDelete(maps[m]);
+    }
+    remove("test.snapshot");
+}
+
+/**
+ * Tests the integer key map, including keys zero and the largest, removals
+ * that shift clusters and iteration.
+ * @param test
+ */
+void testIntHashMap(CuTest* test)
+{
+    IntHashMap* map = intHashMapNew(4);
+    int numKeys = 5000;
+
+    for (int i = 0; i < numKeys; i++)
+    {
+        intHashMapPut(map, (uint64_t)i << 40, i);
+    }
+    intHashMapPut(map, UINT64_MAX, -1);
+    intHashMapPut(map, 0, 7);
+    CuAssertIntEquals(test, numKeys + 1, intHashMapSize(map));
+    CuAssertTrue(test, intHashMapCapacity(map) * 0.75 >= intHashMapSize(map));
+    CuAssertIntEquals(test, 7, *intHashMapGet(map, 0));
+    CuAssertIntEquals(test, -1, *intHashMapGet(map, UINT64_MAX));
+    CuAssertPtrEquals(test, NULL, intHashMapGet(map, 1));
+
+    int inserted;
+    CuAssertIntEquals(test, 1, *intHashMapGetOrInsert(map, (uint64_t)1 << 40, 99, &inserted));
+    CuAssertIntEquals(test, 0, inserted);
+    CuAssertIntEquals(test, 99, *intHashMapGetOrInsert(map, 1, 99, &inserted));
+    CuAssertIntEquals(test, 1, inserted);
+
+    for (int i = 0; i < numKeys; i += 2)
+    {
+        CuAssertIntEquals(test, 1, intHashMapRemove(map, (uint64_t)i << 40));
+    }
+    CuAssertIntEquals(test, 0, intHashMapRemove(map, 0));
+    for (int i = 1; i < numKeys; i += 2)
+    {
+        CuAssertIntEquals(test, i, *intHashMapGet(map, (uint64_t)i << 40));
+    }
+
+    IntHashMapIterator iterator;
+    uint64_t key;
+    int* value;
+    long long sum = 0;
+    int count = 0;
+    intHashMapIteratorInit(&iterator, map);
+    while (intHashMapIteratorNext(&iterator, &key, &value))
+    {
+        CuAssertTrue(test, intHashMapGet(map, key) == value);
+        sum += *value;
+        count++;
+    }
+    CuAssertIntEquals(test, intHashMapSize(map), count);
+    CuAssertTrue(test, sum == (long long)(numKeys / 2) * (numKeys / 2) - 1 + 99);
+
+    // The table honours its load factors, shrinking once removals leave it
+    // below the minimum load.
+    intHashMapSetLoadFactors(map, 0.5, 0.2);
+    CuAssertIntEquals(test, 8192, intHashMapCapacity(map));
+    for (int i = 1; i < 4000; i += 2)
+    {
+        CuAssertIntEquals(test, 1, intHashMapRemove(map, (uint64_t)i << 40));
+    }
+    CuAssertIntEquals(test, 502, intHashMapSize(map));
+    CuAssertTrue(test, intHashMapCapacity(map) < 8192);
+    intHashMapShrinkToFit(map);
+    CuAssertIntEquals(test, 1024, intHashMapCapacity(map));
+    intHashMapReserve(map, 3000);
+    CuAssertIntEquals(test, 8192, intHashMapCapacity(map));
+    const IntHashMap* readOnly = map;
+    for (int i = 4001; i < numKeys; i += 2)
+    {
+        CuAssertIntEquals(test, 1, intHashMapContainsKey(readOnly, (uint64_t)i << 40));
+        CuAssertIntEquals(test, i, *intHashMapGet(readOnly, (uint64_t)i << 40));
+    }
+    intHashMapDelete(map);
+
+    // A map holds the number of keys it was created for without growing.
+    map = intHashMapNew(1000);
+    int capacity = intHashMapCapacity(map);
+    for (int i = 0; i < 1000; i++)
+    {
+        intHashMapPut(map, i, i);
+    }
+    CuAssertIntEquals(test, capacity, intHashMapCapacity(map));
+    intHashMapDelete(map);
+}
+
+/**
+ * Tests splitting text into words, with words and gaps that straddle 16 byte
+ * blocks and bytes outside ASCII.
+ * @param test
+ */
+void testSplitWords(CuTest* test)
+{
+    char text[] = "  don't\r\nstop-believing!! \xe9t\xe9 abcdefghijklmnopqrstuvwxyz0123 "
+                  "                                   x9";
+    const char* expected[] = { "don't", "stop", "believing", "t",
+                               "abcdefghijklmnopqrstuvwxyz0123", "x9" };
+    int count;
+    // Size includes the null terminator, which is the spare byte.
+    char** words = splitWords(text, sizeof(text) - 1, &count);
+
+    CuAssertIntEquals(test, 6, count);
+    for (int i = 0; i < count && i < 6; i++)
+    {
+        CuAssertStrEquals(test, expected[i], words[i]);
+    }
+    free(words);
+}
+
+/**
+ * Tests that a map borrowing its keys stores the caller's pointers.
+ * @param test
+ */
+void testBorrowedKeys(CuTest* test)
+{
+    char buffer[] = "alpha beta gamma";
+    int count;
+    char** words = splitWords(buffer, sizeof(buffer) - 1, &count);
+    HashMap* map = hashMapNewEngine(4, HASH_MAP_GROUP_PROBING);
+    HashMapIterator iterator;
+    const char* key;
+    int* value;
+
+    hashMapSetBorrowedKeys(map, 1);
+    hashMapPutBatch(map, (const char**)words, count, 1);
+    hashMapIteratorInit(&iterator, map);
+    while (hashMapIteratorNext(&iterator, &key, &value))
+    {
+        CuAssertTrue(test, key >= buffer && key < buffer + sizeof(buffer));
+    }
+    hashMapRemove(map, "beta");
+    CuAssertIntEquals(test, 2, hashMapSize(map));
+    CuAssertIntEquals(test, 1, hashMapContainsKey(map, "gamma"));
+    hashMapDelete(map);
+    free(words);
+}
+
+/**
+ * Tests that a saved snapshot loads back with the same contents, and that
+ * corrupt or missing files are rejected.
+ * @param test
+ */
+void testSnapshot(CuTest* test)
+{
+    const char* path = "test.snapshot";
+    char key[16];
+    HashMap* map = hashMapNewEngine(8, HASH_MAP_GROUP_PROBING);
+
+    hashMapSetHashFunction(map, hashFunctionFnv1a, 99);
+    for (int i = 0; i < 500; i++)
+    {
+        sprintf(key, "s%d", i);
+        hashMapPut(map, key, i * 3);
+    }
+    CuAssertIntEquals(test, 0, hashMapSave(map, path));
+    hashMapDelete(map);
+
+    map = hashMapLoadSnapshot(path);
+    CuAssertPtrNotNull(test, map);
+    CuAssertIntEquals(test, HASH_MAP_SNAPSHOT, map->engine);
+    CuAssertIntEquals(test, 500, hashMapSize(map));
+    for (int i = 0; i < 500; i++)
+    {
+        sprintf(key, "s%d", i);
+        int* value = hashMapGet(map, key);
+        CuAssertPtrNotNull(test, value);
+        CuAssertIntEquals(test, i * 3, *value);
+    }
+    CuAssertIntEquals(test, 0, hashMapContainsKey(map, "s500"));
+    Histogram hist;
+    histFromTable(&hist, map);
+    CuAssertIntEquals(test, 500, hist.size);
+    histCleanUp(&hist);
+    hashMapDelete(map);
+
+    // A size that disagrees with the occupied slots, which would let a miss
+    // probe a full table forever. The size follows the magic, four 32-bit
+    // fields and the seed in the header.
+    uint64_t wrongSize = 499;
+    FILE* file = fopen(path, "r+b");
+    fseek(file, 32, SEEK_SET);
+    fwrite(&wrongSize, sizeof(wrongSize), 1, file);
+    fclose(file);
+    CuAssertPtrEquals(test, NULL, hashMapLoadSnapshot(path));
+    wrongSize = 500;
+    file = fopen(path, "r+b");
+    fseek(file, 32, SEEK_SET);
+    fwrite(&wrongSize, sizeof(wrongSize), 1, file);
+    fclose(file);
+    map = hashMapLoadSnapshot(path);
+    CuAssertPtrNotNull(test, map);
+    hashMapDelete(map);
+
+    // Flip one byte of the payload.
+    file = fopen(path, "r+b");
+    fseek(file, -3, SEEK_END);
+    fputc('#', file);
+    fclose(file);
+    CuAssertPtrEquals(test, NULL, hashMapLoadSnapshot(path));
+    remove(path);
+    CuAssertPtrEquals(test, NULL, hashMapLoadSnapshot(path));
+}
+
+void testFrozenMap(CuTest* test)
+{
+    char key[16];
+    HashMap* map = hashMapNew(8);
+
+    for (int i = 0; i < 5000; i++)
+    {
+        sprintf(key, "f%d", i);
+        hashMapPut(map, key, i);
+    }
+    FrozenMap* frozen = frozenMapNew(map);
+    hashMapDelete(map);
+    CuAssertPtrNotNull(test, frozen);
+    CuAssertIntEquals(test, 5000, frozenMapSize(frozen));
+    for (int i = 0; i < 5000; i++)
+    {
+        sprintf(key, "f%d", i);
+        const int* value = frozenMapGet(frozen, key);
+        CuAssertPtrNotNull(test, value);
+        CuAssertIntEquals(test, i, *value);
+    }
+    CuAssertIntEquals(test, 0, frozenMapContainsKey(frozen, "f5000"));
+    CuAssertIntEquals(test, 0, frozenMapContainsKey(frozen, ""));
+
+    // Every entry holds a different key, at its own index.
+    for (int i = 0; i < frozenMapSize(frozen); i++)
+    {
+        CuAssertTrue(test, frozenMapValue(frozen, i) ==
+                               frozenMapGet(frozen, frozenMapKey(frozen, i)));
+    }
+
+    // Batched lookups agree with single ones, across several blocks.
+    const char* queries[1000];
+    const int* values[1000];
+    char (*queryKeys)[16] = malloc(sizeof(*queryKeys) * 1000);
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(queryKeys[i], "f%d", i * 9);
+        queries[i] = queryKeys[i];
+    }
+    CuAssertIntEquals(test, 556, frozenMapGetBatch(frozen, queries, 1000, values));
+    for (int i = 0; i < 1000; i++)
+    {
+        CuAssertTrue(test, values[i] == frozenMapGet(frozen, queries[i]));
+    }
+    free(queryKeys);
+
+    // A saved map loads back with the same entries, in the same order.
+    const char* path = "test.frozen";
+    CuAssertIntEquals(test, 0, frozenMapSave(frozen, path));
+    FrozenMap* loaded = frozenMapLoad(path);
+    CuAssertPtrNotNull(test, loaded);
+    CuAssertIntEquals(test, 5000, frozenMapSize(loaded));
+    for (int i = 0; i < frozenMapSize(loaded); i++)
+    {
+        CuAssertStrEquals(test, frozenMapKey(frozen, i), frozenMapKey(loaded, i));
+        CuAssertTrue(test, frozenMapValue(loaded, i) ==
+                               frozenMapGet(loaded, frozenMapKey(loaded, i)));
+    }
+    CuAssertIntEquals(test, 0, frozenMapContainsKey(loaded, "f5000"));
+    frozenMapDelete(loaded);
+    frozenMapDelete(frozen);
+
+    // Flip one byte of the keys.
+    FILE* file = fopen(path, "r+b");
+    fseek(file, -3, SEEK_END);
+    fputc('#', file);
+    fclose(file);
+    CuAssertPtrEquals(test, NULL, frozenMapLoad(path));
+    remove(path);
+    CuAssertPtrEquals(test, NULL, frozenMapLoad(path));
+
+    const char* words[] = {"cat", "dog", "cat", "eel"};
+    frozen = frozenMapNewWords(words, 4, 7);
+    CuAssertIntEquals(test, 3, frozenMapSize(frozen));
+    CuAssertIntEquals(test, 7, *frozenMapGet(frozen, "eel"));
+    CuAssertIntEquals(test, 0, frozenMapContainsKey(frozen, "cow"));
+    frozenMapDelete(frozen);
+
+    frozen = frozenMapNewWords(words, 0, 0);
+    CuAssertIntEquals(test, 0, frozenMapSize(frozen));
+    CuAssertIntEquals(test, 0, frozenMapContainsKey(frozen, "cat"));
+    CuAssertIntEquals(test, 0, frozenMapSave(frozen, path));
+    frozenMapDelete(frozen);
+    frozen = frozenMapLoad(path);
+    CuAssertPtrNotNull(test, frozen);
+    CuAssertIntEquals(test, 0, frozenMapSize(frozen));
+    CuAssertIntEquals(test, 0, frozenMapContainsKey(frozen, "cat"));
+    frozenMapDelete(frozen);
+    remove(path);
+}
+
+void testTopK(CuTest* test)
+{
+    const char* words[] = {"pear", "fig", "plum", "kiwi", "lime", "date", "apple"};
+    int distances[] = {3, 1, 2, 2, 2, 5, 1};
+    int weights[] = {0, 0, 0, 0, 1, 0, 0};
+    const char* expected[] = {"apple", "fig", "lime", "kiwi"};
+    const char* kept[4];
+    int keptDistances[4];
+    TopK selection;
+
+    topKInit(&selection, 4);
+    CuAssertIntEquals(test, INT_MAX, topKBound(&selection));
+    // Offer the words forwards and backwards; the result must not change.
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < 7; i++)
+        {
+            int j = pass == 0 ? i : 6 - i;
+            topKOffer(&selection, words[j], distances[j], weights[j]);
+        }
+        CuAssertIntEquals(test, 2, topKBound(&selection));
+        CuAssertIntEquals(test, 0, topKOffer(&selection, "zebra", 2, 0));
+        CuAssertIntEquals(test, 4, topKSorted(&selection, kept, keptDistances));
+        for (int i = 0; i < 4; i++)
+        {
+            CuAssertStrEquals(test, expected[i], kept[i]);
+        }
+        CuAssertIntEquals(test, 1, keptDistances[0]);
+        CuAssertIntEquals(test, 2, keptDistances[3]);
+        CuAssertIntEquals(test, 0, selection.size);
+    }
+    topKRelease(&selection);
+}
+
+// Orders words by distance to bruteQuery, then alphabetically.
+static const char* bruteQuery;
+
+static int compareByDistance(const void* a, const void* b)
+{
+    const char* s1 = *(const char**)a;
+    const char* s2 = *(const char**)b;
+    int d1 = levenshtein(bruteQuery, s1);
+    int d2 = levenshtein(bruteQuery, s2);
+    return d1 != d2 ? d1 - d2 : strcmp(s1, s2);
+}
+
+void testSuggestionScan(CuTest* test)
+{
+    const int numWords = 2000;
+    char (*words)[16] = malloc(sizeof(*words) * numWords);
+    const char** sorted = malloc(sizeof(char*) * numWords);
+    TopK selection;
+
+    topKInit(&selection, 5);
+    for (int i = 0; i < numWords; i++)
+    {
+        sprintf(words[i], "w%dx%d", i * 7919 % 1000, i % 13);
+        sorted[i] = words[i];
+    }
+    FrozenMap* dictionary = frozenMapNewWords(sorted, numWords, 0);
+    CuAssertIntEquals(test, numWords, frozenMapSize(dictionary));
+
+    const char* queries[] = {"w12x3", "w999", "x", "w5x50", "abc"};
+    for (int q = 0; q < 5; q++)
+    {
+        const char* nearest[5];
+        int distances[5];
+        CuAssertIntEquals(test, 5, suggestionScan(dictionary, queries[q], INT_MAX, &selection));
+        CuAssertIntEquals(test, 5, topKSorted(&selection, nearest, distances));
+        bruteQuery = queries[q];
+        qsort(sorted, numWords, sizeof(char*), compareByDistance);
+        for (int i = 0; i < 5; i++)
+        {
+            CuAssertStrEquals(test, sorted[i], nearest[i]);
+            CuAssertIntEquals(test, levenshtein(queries[q], sorted[i]), distances[i]);
+        }
+    }
+
+    // Only words within the distance limit are returned.
+    const char* nearest[5];
+    int distances[5];
+    int withinOne = 0;
+    for (int i = 0; i < numWords; i++)
+    {
+        withinOne += levenshtein("w12x", words[i]) <= 1;
+    }
+    CuAssertTrue(test, withinOne > 0 && withinOne < 5);
+    CuAssertIntEquals(test, withinOne, suggestionScan(dictionary, "w12x", 1, &selection));
+    CuAssertIntEquals(test, withinOne, topKSorted(&selection, nearest, distances));
+    CuAssertIntEquals(test, 1, distances[withinOne - 1]);
+    CuAssertIntEquals(test, 0, suggestionScan(dictionary, "abc", 1, &selection));
+
+    // Words longer than MAX_WORD_LENGTH get no suggestions.
+    char longWord[MAX_WORD_LENGTH + 2];
+    memset(longWord, 'w', MAX_WORD_LENGTH + 1);
+    longWord[MAX_WORD_LENGTH + 1] = '\0';
+    CuAssertIntEquals(test, 0, suggestionScan(dictionary, longWord, INT_MAX, &selection));
+    CuAssertIntEquals(test, 0, suggestionScanParallel(dictionary, longWord, INT_MAX,
+                                                      &selection, 4));
+    CuAssertIntEquals(test, 5, suggestionScan(dictionary, longWord + 1, INT_MAX, &selection));
+    topKClear(&selection);
+
+    topKRelease(&selection);
+    frozenMapDelete(dictionary);
+    free(sorted);
+    free(words);
+}
+
+// Full dynamic programming table, to check the faster distances against.
+static int referenceLevenshtein(const char* s1, const char* s2)
+{
+    int len1 = strlen(s1);
+    int len2 = strlen(s2);
+    int* table = malloc(sizeof(int) * (len1 + 1) * (len2 + 1));
+    for (int i = 0; i <= len1; i++)
+    {
+        for (int j = 0; j <= len2; j++)
+        {
+            int* cell = &table[i * (len2 + 1) + j];
+            if (i == 0 || j == 0)
+            {
+                *cell = i + j;
+                continue;
+            }
+            int best = cell[-(len2 + 1) - 1] + (s1[i - 1] != s2[j - 1]);
+            if (cell[-(len2 + 1)] + 1 < best)
+            {
+                best = cell[-(len2 + 1)] + 1;
+            }
+            if (cell[-1] + 1 < best)
+            {
+                best = cell[-1] + 1;
+            }
+            *cell = best;
+        }
+    }
+    int distance = table[len1 * (len2 + 1) + len2];
+    free(table);
+    return distance;
+}
+
+void testEditDistance(CuTest* test)
+{
+    char s1[100];
+    char s2[100];
+    EditPattern pattern;
+
+    CuAssertIntEquals(test, 0, levenshtein("", ""));
+    CuAssertIntEquals(test, 3, levenshtein("abc", ""));
+    CuAssertIntEquals(test, 3, levenshtein("kitten", "sitting"));
+    CuAssertIntEquals(test, 2, levenshteinBounded("kitten", "sitting", 1));
+    CuAssertIntEquals(test, 3, levenshteinBounded("kitten", "sitting", INT_MAX));
+
+    // Random words over a small alphabet, so they share characters, with
+    // lengths on both sides of 64.
+    srand(261);
+    for (int trial = 0; trial < 2000; trial++)
+    {
+        int len1 = rand() % (trial < 1000 ? 12 : 90);
+        int len2 = len1 + rand() % 7 - 3;
+        len2 = len2 < 0 ? 0 : len2;
+        for (int i = 0; i < len1; i++)
+        {
+            s1[i] = 'a' + rand() % 4;
+        }
+        for (int i = 0; i < len2; i++)
+        {
+            s2[i] = rand() % 3 == 0 ? s1[i % (len1 + 1)] : 'a' + rand() % 4;
+        }
+        s1[len1] = '\0';
+        s2[len2] = '\0';
+
+        int expected = referenceLevenshtein(s1, s2);
+        int bound = rand() % 8;
+        int bounded = expected <= bound ? expected : bound + 1;
+        CuAssertIntEquals(test, expected, levenshtein(s1, s2));
+        CuAssertIntEquals(test, expected, levenshtein(s2, s1));
+        CuAssertIntEquals(test, bounded, levenshteinBounded(s1, s2, bound));
+        editPatternInit(&pattern, s1);
+        CuAssertIntEquals(test, expected, editPatternDistance(&pattern, s2, INT_MAX));
+        CuAssertIntEquals(test, bounded, editPatternDistance(&pattern, s2, bound));
+    }
+}
+
+void testQueriesReadOnly(CuTest* test)
+{
+    const char* words[] = {"cat", "cart", "care", "core", "dog", "dot", "cot", "coat", "cast"};
+    const char* queries[] = {"cst", "dgo", "cart", "zzz"};
+    FrozenMap* dictionary = frozenMapNewWords(words, 9, -1);
+    const char* sorted[9];
+    TopK scanned;
+    const char* scanWords[3];
+
+    topKInit(&scanned, 3);
+    for (int q = 0; q < 4; q++)
+    {
+        CuAssertIntEquals(test, 3, suggestionScan(dictionary, queries[q], INT_MAX, &scanned));
+        topKSorted(&scanned, scanWords, NULL);
+        memcpy(sorted, words, sizeof(sorted));
+        bruteQuery = queries[q];
+        qsort(sorted, 9, sizeof(char*), compareByDistance);
+        for (int i = 0; i < 3; i++)
+        {
+            CuAssertStrEquals(test, sorted[i], scanWords[i]);
+        }
+        CuAssertIntEquals(test, q == 2, frozenMapContainsKey(dictionary, queries[q]));
+    }
+
+    // Queries leave the values set when the dictionary was built.
+    for (int i = 0; i < frozenMapSize(dictionary); i++)
+    {
+        CuAssertIntEquals(test, -1, *frozenMapValue(dictionary, i));
+    }
+    topKRelease(&scanned);
+    frozenMapDelete(dictionary);
+}
+
+void testParallelScan(CuTest* test)
+{
+    const int numWords = 3000;
+    char (*words)[16] = malloc(sizeof(*words) * numWords);
+    const char** list = malloc(sizeof(char*) * numWords);
+    const char* expected[5];
+    const char* actual[5];
+    int expectedDistances[5];
+    int actualDistances[5];
+    TopK nearest;
+
+    for (int i = 0; i < numWords; i++)
+    {
+        sprintf(words[i], "p%dq%d", i * 7 % 500, i % 17);
+        list[i] = words[i];
+    }
+    FrozenMap* dictionary = frozenMapNewWords(list, numWords, 0);
+    int threadCounts[] = {1, 2, 3, 8};
+    SuggestionPool* pools[4];
+    topKInit(&nearest, 5);
+    for (int t = 0; t < 4; t++)
+    {
+        pools[t] = suggestionPoolNew(threadCounts[t]);
+        CuAssertIntEquals(test, threadCounts[t], suggestionPoolThreads(pools[t]));
+    }
+
+    // Pools are reused across queries.
+    const char* queries[] = {"p42q", "q7", "p499q16"};
+    for (int q = 0; q < 3; q++)
+    {
+        suggestionScan(dictionary, queries[q], INT_MAX, &nearest);
+        topKSorted(&nearest, expected, expectedDistances);
+        for (int t = 0; t < 8; t++)
+        {
+            int found = t < 4 ? suggestionScanParallel(dictionary, queries[q], INT_MAX,
+                                                       &nearest, threadCounts[t])
+                              : suggestionPoolScan(pools[t - 4], dictionary, queries[q],
+                                                   INT_MAX, &nearest);
+            CuAssertIntEquals(test, 5, found);
+            topKSorted(&nearest, actual, actualDistances);
+            for (int i = 0; i < 5; i++)
+            {
+                CuAssertStrEquals(test, expected[i], actual[i]);
+                CuAssertIntEquals(test, expectedDistances[i], actualDistances[i]);
+            }
+        }
+    }
+    // More threads than words.
+    frozenMapDelete(dictionary);
+    dictionary = frozenMapNewWords(list, 2, 0);
+    CuAssertIntEquals(test, 2, suggestionScanParallel(dictionary, "p", INT_MAX, &nearest, 8));
+    topKClear(&nearest);
+    CuAssertIntEquals(test, 2, suggestionPoolScan(pools[3], dictionary, "p", INT_MAX, &nearest));
+    for (int t = 0; t < 4; t++)
+    {
+        suggestionPoolDelete(pools[t]);
+    }
+
+    topKRelease(&nearest);
+    frozenMapDelete(dictionary);
+    free(list);
+    free(words);
+}
+
+void testSuggestionIndex(CuTest* test)
+{
+    const int numWords = 3000;
+    char (*words)[24] = malloc(sizeof(*words) * numWords);
+    const char** list = malloc(sizeof(char*) * numWords);
+    const char* expected[5];
+    const char* actual[5];
+    int expectedDistances[5];
+    int actualDistances[5];
+    TopK nearest;
+
+    // Words longer and shorter than the indexed prefix, some repeating
+    // letters so that a word has the same deletion string more than once.
+    for (int i = 0; i < numWords; i++)
+    {
+        sprintf(words[i], i % 3 == 0 ? "r%d" : i % 3 == 1 ? "aab%dzz%d" : "spell%dcheck%d",
+                i * 7919 % 1000, i % 11);
+        list[i] = words[i];
+    }
+    FrozenMap* dictionary = frozenMapNewWords(list, numWords, 0);
+    SuggestionIndex* index = suggestionIndexNew(dictionary);
+    SuggestionPool* pool = suggestionPoolNew(2);
+    topKInit(&nearest, 5);
+
+    // Near misses, answered by the index, and words with fewer than five
+    // words within SUGGESTION_INDEX_DISTANCE, which fall back to a scan.
+    const char* queries[] = {"r12", "r", "ab12zz3", "aab999zz10", "spel5check4",
+                             "xspell17check9y", "qqqqqqqqq", "", "aab1zz"};
+    int maxDistances[] = {INT_MAX, 1, 2, 3};
+    for (int q = 0; q < 9; q++)
+    {
+        for (int m = 0; m < 4; m++)
+        {
+            int count = suggestionScan(dictionary, queries[q], maxDistances[m], &nearest);
+            topKSorted(&nearest, expected, expectedDistances);
+            for (int p = 0; p < 2; p++)
+            {
+                CuAssertIntEquals(test, count,
+                                  suggestionIndexQuery(index, p == 0 ? NULL : pool, queries[q],
+                                                       maxDistances[m], &nearest));
+                topKSorted(&nearest, actual, actualDistances);
+                for (int i = 0; i < count; i++)
+                {
+                    CuAssertStrEquals(test, expected[i], actual[i]);
+                    CuAssertIntEquals(test, expectedDistances[i], actualDistances[i]);
+                }
+            }
+        }
+    }
+
+    // Words longer than MAX_WORD_LENGTH get no suggestions.
+    char longWord[MAX_WORD_LENGTH + 2];
+    memset(longWord, 'r', MAX_WORD_LENGTH + 1);
+    longWord[MAX_WORD_LENGTH + 1] = '\0';
+    CuAssertIntEquals(test, 0, suggestionIndexQuery(index, NULL, longWord, INT_MAX, &nearest));
+
+    suggestionPoolDelete(pool);
+    suggestionIndexDelete(index);
+    topKRelease(&nearest);
+    frozenMapDelete(dictionary);
+    free(list);
+    free(words);
+}
+
+void testConcurrentHashMap(CuTest* test)
+{
+    ConcurrentHashMap* map = concurrentHashMapNew(4, 4);
+    char key[16];
+    int value;
+
+    // Each segment's reader counters have a cache line of their own.
+    for (int i = 0; i < 4; i++)
+    {
+        ConcurrentSegment* segment = &map->segments[i];
+        CuAssertIntEquals(test, 0, (int)((uintptr_t)segment->readers % CACHE_LINE_SIZE));
+        CuAssertTrue(test, (char*)&segment->readerIndex - (char*)segment->readers >=
+                               CACHE_LINE_SIZE);
+    }
+
+    // Enough keys to resize every segment several times.
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key%d", i);
+        concurrentHashMapPut(map, key, i);
+    }
+    concurrentHashMapPut(map, "key7", -7);
+    CuAssertIntEquals(test, 1000, concurrentHashMapSize(map));
+    for (int i = 0; i < 1000; i += 2)
+    {
+        sprintf(key, "key%d", i);
+        CuAssertIntEquals(test, 1, concurrentHashMapRemove(map, key));
+        CuAssertIntEquals(test, 0, concurrentHashMapRemove(map, key));
+    }
+    CuAssertIntEquals(test, 500, concurrentHashMapSize(map));
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key%d", i);
+        CuAssertIntEquals(test, i % 2, concurrentHashMapContainsKey(map, key));
+        if (i % 2 == 1)
+        {
+            CuAssertIntEquals(test, 1, concurrentHashMapGet(map, key, &value));
+            CuAssertIntEquals(test, i == 7 ? -7 : i, value);
+        }
+    }
+    concurrentHashMapDelete(map);
+}
+
+#define CONCURRENT_WRITERS 4
+#define CONCURRENT_KEYS 3000
+
+typedef struct ConcurrentTask ConcurrentTask;
+
+struct ConcurrentTask
+{
+    ConcurrentHashMap* map;
+    int writer;
+    // Set by readers that saw a value no writer ever stored.
+    int wrongValues;
+};
+
+static void* concurrentWrite(void* argument)
+{
+    ConcurrentTask* task = argument;
+    char key[16];
+    for (int i = 0; i < CONCURRENT_KEYS; i++)
+    {
+        sprintf(key, "w%dk%d", task->writer, i);
+        concurrentHashMapPut(task->map, key, i);
+    }
+    // Leave every third key.
+    for (int i = 0; i < CONCURRENT_KEYS; i++)
+    {
+        if (i % 3 != 0)
+        {
+            sprintf(key, "w%dk%d", task->writer, i);
+            concurrentHashMapRemove(task->map, key);
+        }
+    }
+    return NULL;
+}
+
+static void* concurrentRead(void* argument)
+{
+    ConcurrentTask* task = argument;
+    char key[16];
+    int value;
+    for (int round = 0; round < 3; round++)
+    {
+        for (int w = 0; w < CONCURRENT_WRITERS; w++)
+        {
+            for (int i = 0; i < CONCURRENT_KEYS; i++)
+            {
+                sprintf(key, "w%dk%d", w, i);
+                if (concurrentHashMapGet(task->map, key, &value) && value != i)
+                {
+                    task->wrongValues++;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+void testConcurrentHashMapThreads(CuTest* test)
+{
+    ConcurrentHashMap* map = concurrentHashMapNew(16, 8);
+    pthread_t threads[CONCURRENT_WRITERS + 2];
+    ConcurrentTask tasks[CONCURRENT_WRITERS + 2];
+    char key[16];
+
+    for (int t = 0; t < CONCURRENT_WRITERS + 2; t++)
+    {
+        tasks[t].map = map;
+        tasks[t].writer = t;
+        tasks[t].wrongValues = 0;
+        CuAssertIntEquals(test, 0, pthread_create(&threads[t], NULL,
+                                                  t < CONCURRENT_WRITERS ? concurrentWrite
+                                                                         : concurrentRead,
+                                                  &tasks[t]));
+    }
+    for (int t = 0; t < CONCURRENT_WRITERS + 2; t++)
+    {
+        pthread_join(threads[t], NULL);
+        CuAssertIntEquals(test, 0, tasks[t].wrongValues);
+    }
+
+    CuAssertIntEquals(test, CONCURRENT_WRITERS * CONCURRENT_KEYS / 3, concurrentHashMapSize(map));
+    for (int w = 0; w < CONCURRENT_WRITERS; w++)
+    {
+        for (int i = 0; i < CONCURRENT_KEYS; i++)
+        {
+            sprintf(key, "w%dk%d", w, i);
+            CuAssertIntEquals(test, i % 3 == 0, concurrentHashMapContainsKey(map, key));
+        }
+    }
+    concurrentHashMapDelete(map);
+}
+
+void testShardedHashMap(CuTest* test)
+{
+    HashMapEngine engines[] = {HASH_MAP_CHAINED, HASH_MAP_LINEAR_PROBING, HASH_MAP_GROUP_PROBING};
+    const char* batch[] = {"b1", "b2", "b3", "b2", "key5"};
+    char key[16];
+    int value;
+
+    for (int e = 0; e < 3; e++)
+    {
+        ShardedHashMap* map = shardedHashMapNew(8, 5, engines[e]);
+        CuAssertIntEquals(test, 8, map->shardCount);
+        // Each shard's lock has a cache line of its own.
+        for (int i = 0; i < 8; i++)
+        {
+            CuAssertIntEquals(test, 0,
+                              (int)((uintptr_t)&map->shards[i].lock % CACHE_LINE_SIZE));
+        }
+        for (int i = 0; i < 500; i++)
+        {
+            sprintf(key, "key%d", i);
+            shardedHashMapPut(map, key, i);
+        }
+        shardedHashMapPutBatch(map, batch, 5, -1);
+        CuAssertIntEquals(test, 503, shardedHashMapSize(map));
+        for (int i = 0; i < 500; i += 2)
+        {
+            sprintf(key, "key%d", i);
+            shardedHashMapRemove(map, key);
+        }
+        CuAssertIntEquals(test, 253, shardedHashMapSize(map));
+        for (int i = 0; i < 500; i++)
+        {
+            sprintf(key, "key%d", i);
+            CuAssertIntEquals(test, i % 2, shardedHashMapContainsKey(map, key));
+            CuAssertIntEquals(test, i % 2, shardedHashMapGet(map, key, &value));
+            if (i % 2 == 1)
+            {
+                CuAssertIntEquals(test, i == 5 ? -1 : i, value);
+            }
+        }
+        CuAssertIntEquals(test, 1, shardedHashMapGet(map, "b2", &value));
+        CuAssertIntEquals(test, -1, value);
+
+        // The totals add up the shards.
+        int size = 0;
+        int capacity = 0;
+        int empty = 0;
+        for (int s = 0; s < map->shardCount; s++)
+        {
+            size += hashMapSize(map->shards[s].map);
+            capacity += hashMapCapacity(map->shards[s].map);
+            empty += hashMapEmptyBuckets(map->shards[s].map);
+            // Every shard got a share of the keys and grew on its own.
+            CuAssertTrue(test, hashMapSize(map->shards[s].map) > 0);
+        }
+        CuAssertIntEquals(test, size, shardedHashMapSize(map));
+        CuAssertIntEquals(test, capacity, shardedHashMapCapacity(map));
+        CuAssertIntEquals(test, empty, shardedHashMapEmptyBuckets(map));
+        CuAssertDblEquals(test, size / (double)capacity, shardedHashMapTableLoad(map), 0.0001);
+        shardedHashMapDelete(map);
+    }
+}
+
+#define SHARDED_WRITERS 4
+#define SHARDED_KEYS 5000
+
+typedef struct ShardedTask ShardedTask;
+
+struct ShardedTask
+{
+    ShardedHashMap* map;
+    int writer;
+    char (*keys)[16];
+    const char** batch;
+};
+
+static void* shardedWrite(void* argument)
+{
+    ShardedTask* task = argument;
+    // Half the keys one at a time, the other half as a batch.
+    for (int i = 0; i < SHARDED_KEYS; i++)
+    {
+        sprintf(task->keys[i], "w%dk%d", task->writer, i);
+        task->batch[i] = task->keys[i];
+    }
+    for (int i = 0; i < SHARDED_KEYS / 2; i++)
+    {
+        shardedHashMapPut(task->map, task->keys[i], task->writer);
+    }
+    shardedHashMapPutBatch(task->map, task->batch + SHARDED_KEYS / 2,
+                           SHARDED_KEYS - SHARDED_KEYS / 2, task->writer);
+    return NULL;
+}
+
+void testShardedHashMapThreads(CuTest* test)
+{
+    ShardedHashMap* map = shardedHashMapNew(16, 4, HASH_MAP_GROUP_PROBING);
+    pthread_t threads[SHARDED_WRITERS];
+    ShardedTask tasks[SHARDED_WRITERS];
+    int value;
+
+    for (int t = 0; t < SHARDED_WRITERS; t++)
+    {
+        tasks[t].map = map;
+        tasks[t].writer = t;
+        tasks[t].keys = malloc(sizeof(*tasks[t].keys) * SHARDED_KEYS);
+        tasks[t].batch = malloc(sizeof(char*) * SHARDED_KEYS);
+        CuAssertIntEquals(test, 0, pthread_create(&threads[t], NULL, shardedWrite, &tasks[t]));
+    }
+    for (int t = 0; t < SHARDED_WRITERS; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    CuAssertIntEquals(test, SHARDED_WRITERS * SHARDED_KEYS, shardedHashMapSize(map));
+    for (int t = 0; t < SHARDED_WRITERS; t++)
+    {
+        for (int i = 0; i < SHARDED_KEYS; i++)
+        {
+            CuAssertIntEquals(test, 1, shardedHashMapGet(map, tasks[t].keys[i], &value));
+            CuAssertIntEquals(test, t, value);
+        }
+        free(tasks[t].keys);
+        free(tasks[t].batch);
+    }
+    shardedHashMapDelete(map);
+}
+
+/**
+ * Collects the misspellings of a checked document.
+ */
+typedef struct CheckedWords CheckedWords;
+
+struct CheckedWords
+{
+    char words[8][16];
+    long long offsets[8];
+    int count;
+};
+
+static void collectMisspelling(const char* word, long long offset, void* context)
+{
+    CheckedWords* checked = context;
+    if (checked->count < 8)
+    {
+        snprintf(checked->words[checked->count], 16, "%s", word);
+        checked->offsets[checked->count] = offset;
+    }
+    checked->count++;
+}
+
+void testCheckDocument(CuTest* test)
+{
+    const char* words[] = {"the", "cat", "sat", "don't", "on", "mat"};
+    FrozenMap* dictionary = frozenMapNewWords(words, 6, 0);
+    CheckedWords checked = {{{0}}, {0}, 0};
+    FILE* document = tmpfile();
+
+    // Misspellings: one at the start, one cut by the end of the first block,
+    // one longer than a whole block and one at the very end. Numbers are not
+    // checked and case is ignored.
+    fputs("Teh cat, 2024 DON'T sat:", document);
+    long long cutOffset = 64 * 1024 - 3;
+    for (long long i = ftell(document); i < cutOffset; i++)
+    {
+        fputc(i % 4 == 0 ? '\n' : ' ', document);
+    }
+    fputs("catt the ", document);
+    long long longOffset = ftell(document);
+    for (int i = 0; i < 100000; i++)
+    {
+        fputc('z', document);
+    }
+    fputs(" on\tmat mta", document);
+    long long endOffset = ftell(document) - 3;
+    rewind(document);
+
+    CuAssertIntEquals(test, 10, (int)checkDocument(document, dictionary,
+                                                   collectMisspelling, &checked));
+    CuAssertIntEquals(test, 4, checked.count);
+    CuAssertStrEquals(test, "teh", checked.words[0]);
+    CuAssertTrue(test, checked.offsets[0] == 0);
+    CuAssertStrEquals(test, "catt", checked.words[1]);
+    CuAssertTrue(test, checked.offsets[1] == cutOffset);
+    CuAssertStrEquals(test, "zzzzzzzzzzzzzzz", checked.words[2]);
+    CuAssertTrue(test, checked.offsets[2] == longOffset);
+    CuAssertStrEquals(test, "mta", checked.words[3]);
+    CuAssertTrue(test, checked.offsets[3] == endOffset);
+
+    // An empty document.
+    fclose(document);
+    document = tmpfile();
+    checked.count = 0;
+    CuAssertIntEquals(test, 0, (int)checkDocument(document, dictionary,
+                                                  collectMisspelling, &checked));
+    CuAssertIntEquals(test, 0, checked.count);
+
+    // A word longer than MAX_WORD_LENGTH is misspelled even if the dictionary
+    // has it, and the words around it are still looked up.
+    char longWord[MAX_WORD_LENGTH + 2];
+    memset(longWord, 'q', MAX_WORD_LENGTH + 1);
+    longWord[MAX_WORD_LENGTH + 1] = '\0';
+    const char* longWords[] = {longWord, longWord + 1};
+    frozenMapDelete(dictionary);
+    dictionary = frozenMapNewWords(longWords, 2, 0);
+    fclose(document);
+    document = tmpfile();
+    fprintf(document, "%s %s qq %s", longWord, longWord + 1, longWord + 1);
+    rewind(document);
+    CuAssertIntEquals(test, 4, (int)checkDocument(document, dictionary,
+                                                  collectMisspelling, &checked));
+    CuAssertIntEquals(test, 2, checked.count);
+    CuAssertTrue(test, checked.offsets[0] == 0);
+    CuAssertStrEquals(test, "qq", checked.words[1]);
+    CuAssertTrue(test, checked.offsets[1] == 2 * MAX_WORD_LENGTH + 3);
+
+    fclose(document);
+    frozenMapDelete(dictionary);
+}
+
 // --- Test Suite ---
 
 void addAllTests(CuSuite* suite)
@@ -349,6 +2252,39 @@ void addAllTests(CuSuite* suite)
     SUITE_ADD_TEST(suite, testMultipleUnder);
     SUITE_ADD_TEST(suite, testMultipleOver);
     SUITE_ADD_TEST(suite, testValueUpdate);
+    SUITE_ADD_TEST(suite, testLinearProbingOver);
+    SUITE_ADD_TEST(suite, testLinearProbingRemove);
+    SUITE_ADD_TEST(suite, testGroupProbingOver);
+    SUITE_ADD_TEST(suite, testGroupProbingChurn);
+    SUITE_ADD_TEST(suite, testHashFunctions);
+    SUITE_ADD_TEST(suite, testSetHashFunction);
+    SUITE_ADD_TEST(suite, testResizeUsesCachedHash);
+    SUITE_ADD_TEST(suite, testIncrementalResize);
+    SUITE_ADD_TEST(suite, testMemoryPool);
+    SUITE_ADD_TEST(suite, testArenaChurn);
+    SUITE_ADD_TEST(suite, testGetOrInsert);
+    SUITE_ADD_TEST(suite, testPutBatch);
+    SUITE_ADD_TEST(suite, testGetBatch);
+    SUITE_ADD_TEST(suite, testStats);
+    SUITE_ADD_TEST(suite, testLoadFactors);
+    SUITE_ADD_TEST(suite, testValueHashMap);
+    SUITE_ADD_TEST(suite, testBinaryKeys);
+    SUITE_ADD_TEST(suite, testIntHashMap);
+    SUITE_ADD_TEST(suite, testSplitWords);
+    SUITE_ADD_TEST(suite, testBorrowedKeys);
+    SUITE_ADD_TEST(suite, testSnapshot);
+    SUITE_ADD_TEST(suite, testFrozenMap);
+    SUITE_ADD_TEST(suite, testTopK);
+    SUITE_ADD_TEST(suite, testSuggestionScan);
+    SUITE_ADD_TEST(suite, testEditDistance);
+    SUITE_ADD_TEST(suite, testQueriesReadOnly);
+    SUITE_ADD_TEST(suite, testParallelScan);
+    SUITE_ADD_TEST(suite, testSuggestionIndex);
+    SUITE_ADD_TEST(suite, testConcurrentHashMap);
+    SUITE_ADD_TEST(suite, testConcurrentHashMapThreads);
+    SUITE_ADD_TEST(suite, testShardedHashMap);
+    SUITE_ADD_TEST(suite, testShardedHashMapThreads);
+    SUITE_ADD_TEST(suite, testCheckDocument);
 }
 
 int main()
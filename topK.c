@@ -0,0 +1,161 @@
+/*
+ * CS 261 Data Structures
+ * Bounded selection of the nearest words.
+ */
+
+#include "topK.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+/**
+ * Returns true if entry a ranks below entry b.
+ */
+static int topKWorse(const TopKEntry *a, const TopKEntry *b)
+{
+    if (a->distance != b->distance)
+    {
+        return a->distance > b->distance;
+    }
+    if (a->weight != b->weight)
+    {
+        return a->weight < b->weight;
+    }
+    return strcmp(a->word, b->word) > 0;
+}
+
+/**
+ * Moves the entry at index down the heap until no child is worse than it.
+ */
+static void topKSiftDown(TopKEntry *entries, int size, int index)
+{
+    while (1)
+    {
+        int worst = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < size && topKWorse(&entries[left], &entries[worst]))
+        {
+            worst = left;
+        }
+        if (right < size && topKWorse(&entries[right], &entries[worst]))
+        {
+            worst = right;
+        }
+        if (worst == index)
+        {
+            return;
+        }
+        TopKEntry entry = entries[index];
+        entries[index] = entries[worst];
+        entries[worst] = entry;
+        index = worst;
+    }
+}
+
+/**
+ * Initializes an empty selection.
+ * @param topK
+ * @param capacity Number of words to keep, k.
+ */
+void topKInit(TopK *topK, int capacity)
+{
+    assert(capacity > 0);
+    topK->entries = malloc(sizeof(TopKEntry) * capacity);
+    topK->size = 0;
+    topK->capacity = capacity;
+}
+
+/**
+ * Frees the memory of a selection initialized with topKInit.
+ * @param topK
+ */
+void topKRelease(TopK *topK)
+{
+    free(topK->entries);
+    topK->entries = NULL;
+}
+
+/**
+ * Forgets every word kept, so the selection can be reused.
+ * @param topK
+ */
+void topKClear(TopK *topK)
+{
+    topK->size = 0;
+}
+
+/**
+ * Offers a word. It is kept if fewer than k words are kept or it ranks above
+ * the worst of them, which it then replaces.
+ * @param topK
+ * @param word Word to offer; it is not copied.
+ * @param distance
+ * @param weight Higher weights win ties in distance.
+ * @return 1 if the word is kept, 0 otherwise.
+ */
+int topKOffer(TopK *topK, const char *word, int distance, int weight)
+{
+    TopKEntry entry = {word, distance, weight};
+    TopKEntry *entries = topK->entries;
+
+    if (topK->size < topK->capacity)
+    {
+        // Sift the new entry up from the end.
+        int index = topK->size++;
+        while (index > 0 && topKWorse(&entry, &entries[(index - 1) / 2]))
+        {
+            entries[index] = entries[(index - 1) / 2];
+            index = (index - 1) / 2;
+        }
+        entries[index] = entry;
+        return 1;
+    }
+    if (!topKWorse(&entries[0], &entry))
+    {
+        return 0;
+    }
+    entries[0] = entry;
+    topKSiftDown(entries, topK->size, 0);
+    return 1;
+}
+
+/**
+ * Returns the largest distance a word can have and still be kept: the
+ * distance of the worst word once k words are kept. Words at exactly this
+ * distance may still win a tie, so distances up to it must be exact.
+ * @param topK
+ * @return Distance bound, or INT_MAX while fewer than k words are kept.
+ */
+int topKBound(const TopK *topK)
+{
+    return topK->size < topK->capacity ? INT_MAX : topK->entries[0].distance;
+}
+
+/**
+ * Copies the kept words out, best first. This empties the selection.
+ * @param topK
+ * @param words Array of k words, set to the kept words.
+ * @param distances Array of k distances, set to their distances, or NULL.
+ * @return Number of words kept, at most k.
+ */
+int topKSorted(TopK *topK, const char **words, int *distances)
+{
+    int count = topK->size;
+
+    // Pop the worst entry to the back until the heap is empty.
+    while (topK->size > 0)
+    {
+        int last = --topK->size;
+        TopKEntry worst = topK->entries[0];
+        topK->entries[0] = topK->entries[last];
+        topKSiftDown(topK->entries, last, 0);
+        words[last] = worst.word;
+        if (distances != NULL)
+        {
+            distances[last] = worst.distance;
+        }
+    }
+    return count;
+}
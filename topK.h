@@ -0,0 +1,38 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+/*
+ * Keeps the k best words seen so far by distance, in a max-heap whose root is
+ * the worst word kept, so a new word is compared with it in O(1) and replaces
+ * it in O(log k). Ties are broken by weight, higher first, then
+ * alphabetically, so the result doesn't depend on the order words are
+ * offered in.
+ */
+
+typedef struct TopKEntry TopKEntry;
+typedef struct TopK TopK;
+
+struct TopKEntry
+{
+    // Word owned by the caller.
+    const char* word;
+    int distance;
+    // Preference between words at the same distance, e.g. a frequency.
+    int weight;
+};
+
+struct TopK
+{
+    TopKEntry* entries;
+    int size;
+    int capacity;
+};
+
+void topKInit(TopK* topK, int capacity);
+void topKRelease(TopK* topK);
+void topKClear(TopK* topK);
+int topKOffer(TopK* topK, const char* word, int distance, int weight);
+int topKBound(const TopK* topK);
+int topKSorted(TopK* topK, const char** words, int* distances);
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ * CS 261 Data Structures
+ * Hash map with values of any size stored inline.
+ */
+
+#include "valueHashMap.h"
+#include "hashMap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// Size of the blocks key copies are carved from.
+#define VALUE_KEY_BLOCK (64 * 1024)
+
+// Alignment of values, and of slots so that each slot's value stays aligned.
+struct ValueAlignmentProbe
+{
+    char offset;
+    ValueAlignment aligned;
+};
+#define VALUE_ALIGNMENT offsetof(struct ValueAlignmentProbe, aligned)
+
+/**
+ * Rounds a size up to a multiple of VALUE_ALIGNMENT.
+ */
+static size_t alignValue(size_t size)
+{
+    return (size + VALUE_ALIGNMENT - 1) / VALUE_ALIGNMENT * VALUE_ALIGNMENT;
+}
+
+/**
+ * Returns the slot at the given index.
+ */
+static ValueSlot *slotAt(const ValueHashMap *map, int index)
+{
+    return (ValueSlot *)(map->table.slots + (size_t)index * map->table.slotSize);
+}
+
+/**
+ * Returns the value stored in a slot.
+ */
+static void *slotValue(const ValueHashMap *map, ValueSlot *slot)
+{
+    return (char *)slot + map->valueOffset;
+}
+
+/**
+ * Compares the key of a slot with a string of the given length.
+ */
+static int valueMatch(const ProbeSlot *slot, const void *key, size_t length)
+{
+    const char *stored = ((const ValueSlot *)slot)->key;
+    return strncmp(stored, key, length) == 0 && stored[length] == '\0';
+}
+
+/**
+ * Returns the index of the slot holding the given key, or -1 if the key is not
+ * in the table.
+ * @param search Set to what the search saw, including the free slot that
+ *               ended a failed search. May be NULL.
+ */
+static int valueFind(const ValueHashMap *map, const char *key, size_t length, uint64_t hash,
+                     ProbeSearch *search)
+{
+    return probeTableFind(&map->table, hash, key, length, valueMatch, search);
+}
+
+/**
+ * Hashes a key with the map's hash function and seed.
+ */
+static uint64_t valueHash(const ValueHashMap *map, const char *key, size_t length)
+{
+    return probeHash(map->hashFunction(key, length, map->seed));
+}
+
+/**
+ * Creates a map whose values are blocks of the given size.
+ * @param capacity Number of keys the map holds before it first grows.
+ * @param valueSize Bytes copied in and out for each value.
+ * @param destroy Called on each value the map removes, or NULL.
+ * @return The allocated map.
+ */
+ValueHashMap *valueHashMapNew(int capacity, size_t valueSize, ValueDestructor destroy)
+{
+    ValueHashMap *map = malloc(sizeof(ValueHashMap));
+    map->hashFunction = HASH_FUNCTION;
+    map->seed = HASH_SEED;
+    map->valueSize = valueSize;
+    map->valueOffset = alignValue(sizeof(ValueSlot));
+    map->destroy = destroy;
+    probeTableInit(&map->table, capacity, alignValue(map->valueOffset + valueSize));
+    arenaInit(&map->keyArena, VALUE_KEY_BLOCK);
+    return map;
+}
+
+/**
+ * Destroys every value and frees the map, its keys and itself.
+ * @param map
+ */
+void valueHashMapDelete(ValueHashMap *map)
+{
+    assert(map != 0);
+    if (map->destroy != NULL)
+    {
+        for (int i = 0; i < map->table.capacity; i++)
+        {
+            ValueSlot *slot = slotAt(map, i);
+            if (slot->probe.hash != 0)
+            {
+                map->destroy(slotValue(map, slot));
+            }
+        }
+    }
+    probeTableRelease(&map->table);
+    arenaRelease(&map->keyArena);
+    free(map);
+}
+
+/**
+ * Returns a pointer to the value of the given key, or NULL if the key is not
+ * in the map. The pointer is valid until the map is next modified.
+ * @param map
+ * @param key
+ * @return Value or NULL.
+ */
+void *valueHashMapGet(ValueHashMap *map, const char *key)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    size_t length = strlen(key);
+    int index = valueFind(map, key, length, valueHash(map, key, length), NULL);
+    return index < 0 ? NULL : slotValue(map, slotAt(map, index));
+}
+
+/**
+ * Returns a pointer to the value of the given key, first adding the key with
+ * a zeroed value if it is not in the map. The caller fills in a new value
+ * through the pointer, which is valid until the map is next modified.
+ * @param map
+ * @param key
+ * @param inserted Set to 1 if the key was added, 0 if it existed. May be
+ *                 NULL.
+ * @return Pointer to the key's value.
+ */
+void *valueHashMapGetOrInsert(ValueHashMap *map, const char *key, int *inserted)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    size_t length = strlen(key);
+    uint64_t hash = valueHash(map, key, length);
+    ProbeSearch search;
+    int index = valueFind(map, key, length, hash, &search);
+    if (inserted != NULL)
+    {
+        *inserted = index < 0;
+    }
+    if (index >= 0)
+    {
+        return slotValue(map, slotAt(map, index));
+    }
+
+    ValueSlot *slot = (ValueSlot *)probeTableInsert(&map->table, hash, search.freeIndex);
+    slot->key = arenaAlloc(&map->keyArena, length + 1);
+    memcpy(slot->key, key, length + 1);
+    memset(slotValue(map, slot), 0, map->valueSize);
+    return slotValue(map, slot);
+}
+
+/**
+ * Copies a value into the map under the given key. A value the key already
+ * had is destroyed first.
+ * @param map
+ * @param key
+ * @param value valueSize bytes to copy.
+ * @return Pointer to the stored value, valid until the map is next modified.
+ */
+void *valueHashMapPut(ValueHashMap *map, const char *key, const void *value)
+{
+    assert(value != 0);
+
+    int inserted;
+    void *stored = valueHashMapGetOrInsert(map, key, &inserted);
+    if (!inserted && map->destroy != NULL)
+    {
+        map->destroy(stored);
+    }
+    memcpy(stored, value, map->valueSize);
+    return stored;
+}
+
+/**
+ * Removes the given key and destroys its value. If the key is not in the map,
+ * this does nothing. The table shrinks once it drops below its minimum load.
+ * @param map
+ * @param key
+ * @return 1 if the key was removed, 0 otherwise.
+ */
+int valueHashMapRemove(ValueHashMap *map, const char *key)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    size_t length = strlen(key);
+    int index = valueFind(map, key, length, valueHash(map, key, length), NULL);
+    if (index < 0)
+    {
+        return 0;
+    }
+    ValueSlot *slot = slotAt(map, index);
+    if (map->destroy != NULL)
+    {
+        map->destroy(slotValue(map, slot));
+    }
+    arenaFree(&map->keyArena, slot->key, length + 1);
+    probeTableErase(&map->table, index);
+    return 1;
+}
+
+/**
+ * Returns 1 if the given key is in the map and 0 otherwise.
+ * @param map
+ * @param key
+ * @return 1 if the key is found, 0 otherwise.
+ */
+int valueHashMapContainsKey(const ValueHashMap *map, const char *key)
+{
+    assert(map != 0);
+    assert(key != 0);
+
+    size_t length = strlen(key);
+    return valueFind(map, key, length, valueHash(map, key, length), NULL) >= 0;
+}
+
+/**
+ * Returns the number of keys in the map.
+ * @param map
+ * @return Number of keys.
+ */
+int valueHashMapSize(const ValueHashMap *map)
+{
+    assert(map != 0);
+    return map->table.size;
+}
+
+/**
+ * Returns the number of slots in the table.
+ * @param map
+ * @return Number of slots.
+ */
+int valueHashMapCapacity(const ValueHashMap *map)
+{
+    assert(map != 0);
+    return map->table.capacity;
+}
+
+/**
+ * Sets the loads the table is kept between; see hashMapSetLoadFactors.
+ * @param map
+ * @param maxLoad Largest load, below 1.
+ * @param minLoad Smallest load; 0, the default, never shrinks.
+ */
+void valueHashMapSetLoadFactors(ValueHashMap *map, float maxLoad, float minLoad)
+{
+    assert(map != 0);
+    probeTableSetLoadFactors(&map->table, maxLoad, minLoad);
+}
+
+/**
+ * Grows the table, if needed, so that it can hold the given number of keys
+ * without resizing.
+ * @param map
+ * @param count Number of keys the map should hold.
+ */
+void valueHashMapReserve(ValueHashMap *map, int count)
+{
+    assert(map != 0);
+    probeTableReserve(&map->table, count);
+}
+
+/**
+ * Shrinks the table to the smallest capacity that holds its keys.
+ * @param map
+ */
+void valueHashMapShrinkToFit(ValueHashMap *map)
+{
+    assert(map != 0);
+    probeTableShrinkToFit(&map->table);
+}
+
+/**
+ * Prepares an iterator over every key and value in the map, in table order.
+ * The map must not be modified while the iterator is in use.
+ * @param iterator
+ * @param map
+ */
+void valueHashMapIteratorInit(ValueHashMapIterator *iterator, ValueHashMap *map)
+{
+    assert(map != 0);
+    iterator->map = map;
+    iterator->index = -1;
+}
+
+/**
+ * Advances the iterator to the next key.
+ * @param iterator
+ * @param key Set to the key.
+ * @param value Set to a pointer to the key's value.
+ * @return 1 if a key was found, 0 once every key has been visited.
+ */
+int valueHashMapIteratorNext(ValueHashMapIterator *iterator, const char **key, void **value)
+{
+    ValueHashMap *map = iterator->map;
+    while (++iterator->index < map->table.capacity)
+    {
+        ValueSlot *slot = slotAt(map, iterator->index);
+        if (slot->probe.hash != 0)
+        {
+            *key = slot->key;
+            *value = slotValue(map, slot);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#ifndef VALUE_HASH_MAP_H
+#define VALUE_HASH_MAP_H
+
+/*
+ * Hash map from strings to values of any fixed size, stored inline in the
+ * table next to the key's hash. A lookup returns a pointer straight into the
+ * table, so payloads need no side table indexed by an int. Slots are probed
+ * linearly by a ProbeTable; each is a ValueSlot followed by the value, both
+ * aligned for any type.
+ */
+
+#include "hashFunctions.h"
+#include "memoryPool.h"
+#include "probeTable.h"
+
+typedef struct ValueSlot ValueSlot;
+typedef struct ValueHashMap ValueHashMap;
+typedef struct ValueHashMapIterator ValueHashMapIterator;
+typedef union ValueAlignment ValueAlignment;
+
+// Releases what a value owns, such as memory it points to. The value itself
+// lives in the table and must not be freed.
+typedef void (*ValueDestructor)(void* value);
+
+// Has the strictest alignment of the basic types, which values are given.
+union ValueAlignment
+{
+    long long integer;
+    long double real;
+    void* pointer;
+    void (*function)(void);
+};
+
+struct ValueSlot
+{
+    // Hash is 0 when the slot is empty.
+    ProbeSlot probe;
+    char* key;
+};
+
+struct ValueHashMap
+{
+    HashFunction hashFunction;
+    uint64_t seed;
+    // Bytes of a value, and where it starts in a slot.
+    size_t valueSize;
+    size_t valueOffset;
+    // Called on every value removed from the map, or NULL.
+    ValueDestructor destroy;
+    ProbeTable table;
+    // Copies of the keys.
+    Arena keyArena;
+};
+
+struct ValueHashMapIterator
+{
+    ValueHashMap* map;
+    int index;
+};
+
+ValueHashMap* valueHashMapNew(int capacity, size_t valueSize, ValueDestructor destroy);
+void valueHashMapDelete(ValueHashMap* map);
+void* valueHashMapGet(ValueHashMap* map, const char* key);
+void* valueHashMapGetOrInsert(ValueHashMap* map, const char* key, int* inserted);
+void* valueHashMapPut(ValueHashMap* map, const char* key, const void* value);
+int valueHashMapRemove(ValueHashMap* map, const char* key);
+int valueHashMapContainsKey(const ValueHashMap* map, const char* key);
+int valueHashMapSize(const ValueHashMap* map);
+int valueHashMapCapacity(const ValueHashMap* map);
+void valueHashMapSetLoadFactors(ValueHashMap* map, float maxLoad, float minLoad);
+void valueHashMapReserve(ValueHashMap* map, int count);
+void valueHashMapShrinkToFit(ValueHashMap* map);
+
+void valueHashMapIteratorInit(ValueHashMapIterator* iterator, ValueHashMap* map);
+int valueHashMapIteratorNext(ValueHashMapIterator* iterator, const char** key, void** value);
+
+#endif
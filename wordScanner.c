@@ -0,0 +1,125 @@
+/*
+ * CS 261 Data Structures
+ * Word tokenizer shared by the spell checker's loaders.
+ */
+
+#include "wordScanner.h"
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+/**
+ * Returns a bit mask of the word characters among 16 bytes of text.
+ */
+static unsigned int wordMask(const char *text)
+{
+    __m128i bytes = _mm_loadu_si128((const __m128i *)text);
+    // Bytes of 0x80 and up compare as negative, so they fail every range.
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), bytes));
+    __m128i lower = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                   _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lower));
+    __m128i apostrophe = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\''));
+    return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, letter), apostrophe));
+}
+#endif
+
+/**
+ * Returns true if c can be part of a word: a letter, a digit or an apostrophe.
+ */
+int isWordChar(int c)
+{
+    return (c >= '0' && c <= '9') ||
+           (c >= 'A' && c <= 'Z') ||
+           (c >= 'a' && c <= 'z') ||
+           c == '\'';
+}
+
+/**
+ * Returns the index of the first word character at or after i, or length if
+ * there is none.
+ * @param text
+ * @param i Index to start at.
+ * @param length Number of bytes of text.
+ * @return Start of the next word.
+ */
+size_t scanWordStart(const char *text, size_t i, size_t length)
+{
+#if defined(__SSE2__)
+    while (i + 16 <= length)
+    {
+        unsigned int mask = wordMask(text + i);
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+#endif
+    while (i < length && !isWordChar((unsigned char)text[i]))
+    {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Returns the index of the first non-word character at or after i, or length
+ * if the text ends first.
+ * @param text
+ * @param i Index to start at.
+ * @param length Number of bytes of text.
+ * @return End of the current word.
+ */
+size_t scanWordEnd(const char *text, size_t i, size_t length)
+{
+#if defined(__SSE2__)
+    while (i + 16 <= length)
+    {
+        unsigned int mask = ~wordMask(text + i) & 0xFFFF;
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+#endif
+    while (i < length && isWordChar((unsigned char)text[i]))
+    {
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Splits a buffer into words, terminating each word in place with a null
+ * character. The buffer needs one spare byte after its length for the last
+ * terminator.
+ * @param buffer
+ * @param length Number of bytes of text in the buffer.
+ * @param count Set to the number of words.
+ * @return Allocated array of pointers to the words in the buffer.
+ */
+char **splitWords(char *buffer, size_t length, int *count)
+{
+    int maxWords = 1024;
+    char **words = malloc(sizeof(char *) * maxWords);
+    size_t i = scanWordStart(buffer, 0, length);
+
+    *count = 0;
+    while (i < length)
+    {
+        if (*count == maxWords)
+        {
+            maxWords *= 2;
+            words = realloc(words, sizeof(char *) * maxWords);
+        }
+        words[(*count)++] = buffer + i;
+        i = scanWordEnd(buffer, i, length);
+        buffer[i] = '\0';
+        i = scanWordStart(buffer, i + 1, length);
+    }
+    return words;
+}
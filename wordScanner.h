@@ -0,0 +1,21 @@
+#ifndef WORD_SCANNER_H
+#define WORD_SCANNER_H
+
+#include <stddef.h>
+
+/*
+ * Splits text into words: maximal runs of letters, digits and apostrophes.
+ * Runs are found 16 bytes at a time with SSE2 where available.
+ */
+
+// Longest word that is spell checked. Longer runs, such as encoded data, are
+// reported as misspelled without a lookup and get no suggestions, since a
+// comparison with them costs time in proportion to their length.
+#define MAX_WORD_LENGTH 64
+
+int isWordChar(int c);
+size_t scanWordStart(const char* text, size_t i, size_t length);
+size_t scanWordEnd(const char* text, size_t i, size_t length);
+char** splitWords(char* buffer, size_t length, int* count);
+
+#endif